@@ -0,0 +1,1576 @@
+/* Throughput and memory benchmark for the queue backends */
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "mt19937-64.h"
+#include "psort.h"
+#include "random.h"
+#include "report.h"
+#include "ring.h"
+#include "unrolled.h"
+
+/* Our program needs to use regular malloc/free */
+#define INTERNAL 1
+#include "harness.h"
+
+#include "cdeque.h"
+#include "extsort.h"
+#include "journal.h"
+#include "mpmc.h"
+#include "queue.h"
+#include "shmq.h"
+#include "spsc.h"
+#include "wsdeque.h"
+
+#define BENCH_STRINGS 1024
+#define BENCH_STRLEN 8
+
+typedef void (*visit_func_t)(const char *, void *);
+
+/**
+ * bench_backend_t - Operations of a queue backend under benchmark
+ * @name: name used to select the backend
+ * @create: create an empty queue
+ * @destroy: free the queue and everything in it
+ * @insert_tail: insert a copy of the string at the tail
+ * @remove_head: remove and free the value at the head
+ * @reverse: reverse the queue in place
+ * @traverse: call the visitor on every value from head to tail
+ */
+typedef struct {
+    const char *name;
+    void *(*create)(void);
+    void (*destroy)(void *q);
+    bool (*insert_tail)(void *q, const char *s);
+    bool (*remove_head)(void *q);
+    void (*reverse)(void *q);
+    void (*traverse)(void *q, visit_func_t fn, void *arg);
+} bench_backend_t;
+
+/* Intrusive list of queue.h */
+
+static void *list_create(void)
+{
+    return q_new();
+}
+
+static void list_destroy(void *q)
+{
+    q_free(q);
+}
+
+static bool list_insert_tail(void *q, const char *s)
+{
+    return q_insert_tail(q, (char *) s);
+}
+
+static bool list_remove_head(void *q)
+{
+    element_t *e = q_remove_head(q, NULL, 0);
+    if (!e)
+        return false;
+    q_release_element(e);
+    return true;
+}
+
+static void list_reverse(void *q)
+{
+    q_reverse(q);
+}
+
+static void list_traverse(void *q, visit_func_t fn, void *arg)
+{
+    element_t *entry = NULL;
+    list_for_each_entry (entry, (struct list_head *) q, list)
+        fn(entry->value, arg);
+}
+
+/* Unrolled list of unrolled.h */
+
+static void *unrolled_create(void)
+{
+    return uq_new();
+}
+
+static void unrolled_destroy(void *q)
+{
+    uq_free(q);
+}
+
+static bool unrolled_insert_tail(void *q, const char *s)
+{
+    return uq_insert_tail(q, s);
+}
+
+static bool unrolled_remove_head(void *q)
+{
+    return uq_remove_head(q, NULL, 0);
+}
+
+static void unrolled_reverse(void *q)
+{
+    uq_reverse(q);
+}
+
+static void unrolled_traverse(void *q, visit_func_t fn, void *arg)
+{
+    uq_for_each(q, fn, arg);
+}
+
+/* Ring-buffer deque of ring.h */
+
+static void *ring_create(void)
+{
+    return rq_new();
+}
+
+static void ring_destroy(void *q)
+{
+    rq_free(q);
+}
+
+static bool ring_insert_tail(void *q, const char *s)
+{
+    return rq_insert_tail(q, s);
+}
+
+static bool ring_remove_head(void *q)
+{
+    return rq_remove_head(q, NULL, 0);
+}
+
+static void ring_reverse(void *q)
+{
+    rq_reverse(q);
+}
+
+static void ring_traverse(void *q, visit_func_t fn, void *arg)
+{
+    rq_for_each(q, fn, arg);
+}
+
+static const bench_backend_t backends[] = {
+    {"list", list_create, list_destroy, list_insert_tail, list_remove_head,
+     list_reverse, list_traverse},
+    {"unrolled", unrolled_create, unrolled_destroy, unrolled_insert_tail,
+     unrolled_remove_head, unrolled_reverse, unrolled_traverse},
+    {"ring", ring_create, ring_destroy, ring_insert_tail, ring_remove_head,
+     ring_reverse, ring_traverse},
+};
+
+static char strings[BENCH_STRINGS][BENCH_STRLEN + 1];
+
+/* Fill the string table with random lowercase strings */
+static void init_strings(void)
+{
+    for (int i = 0; i < BENCH_STRINGS; i++) {
+        randombytes((uint8_t *) strings[i], BENCH_STRLEN);
+        for (int j = 0; j < BENCH_STRLEN; j++)
+            strings[i][j] = 'a' + (unsigned char) strings[i][j] % 26;
+        strings[i][BENCH_STRLEN] = '\0';
+    }
+}
+
+/* Touch the first byte of every value, so that traversal has to load it */
+static void visit(const char *s, void *arg)
+{
+    *(size_t *) arg += (unsigned char) s[0];
+}
+
+/* Report the rate of one phase */
+static void report_phase(const char *phase, int n, double t)
+{
+    report(1, "  %-10s %8.3f s  %12.0f ops/sec", phase, t, t > 0 ? n / t : 0);
+}
+
+bool bench_run(const char *name, int n)
+{
+    const bench_backend_t *b = NULL;
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        if (!strcmp(backends[i].name, name))
+            b = &backends[i];
+    }
+    if (!b) {
+        report(1, "Unknown backend '%s'", name);
+        bench_list();
+        return false;
+    }
+
+    init_strings();
+
+    double timer;
+    size_t bytes = allocation_bytes();
+    void *q = b->create();
+    if (!q) {
+        report(1, "ERROR: Could not create queue");
+        return false;
+    }
+
+    bool ok = true;
+    init_time(&timer);
+    for (int i = 0; ok && i < n; i++)
+        ok = b->insert_tail(q, strings[i % BENCH_STRINGS]);
+    double t_insert = delta_time(&timer);
+    bytes = allocation_bytes() - bytes;
+
+    size_t sum = 0;
+    b->traverse(q, visit, &sum);
+    double t_traverse = delta_time(&timer);
+
+    b->reverse(q);
+    double t_reverse = delta_time(&timer);
+
+    for (int i = 0; ok && i < n; i++)
+        ok = b->remove_head(q);
+    double t_remove = delta_time(&timer);
+
+    b->destroy(q);
+    if (!ok) {
+        report(1, "ERROR: Queue operation failed on backend '%s'", name);
+        return false;
+    }
+
+    report(1, "Backend %s, %d elements:", name, n);
+    report_phase("insert", n, t_insert);
+    report_phase("traverse", n, t_traverse);
+    report_phase("reverse", n, t_reverse);
+    report_phase("remove", n, t_remove);
+    report(1, "  memory     %8.1f bytes/element (checksum %zu)",
+           n ? (double) bytes / n : 0.0, sum);
+    return true;
+}
+
+/* Fill buf with BENCH_STRLEN random lowercase letters */
+static void random_string(char *buf)
+{
+    uint64_t r = mt19937_rand();
+    for (int j = 0; j < BENCH_STRLEN; j++, r /= 26)
+        buf[j] = 'a' + r % 26;
+    buf[BENCH_STRLEN] = '\0';
+}
+
+bool bench_sort(int n, int threads)
+{
+    struct list_head *serial = q_new(), *parallel = q_new();
+    bool ok = serial && parallel;
+
+    char buf[BENCH_STRLEN + 1];
+    for (int i = 0; ok && i < n; i++) {
+        random_string(buf);
+        ok = q_insert_tail(serial, buf) && q_insert_tail(parallel, buf);
+    }
+    if (!ok) {
+        report(1, "ERROR: Could not build the queues to sort");
+        q_free(serial);
+        q_free(parallel);
+        return false;
+    }
+
+    double timer;
+    init_time(&timer);
+    q_sort(serial, false);
+    double t_serial = delta_time(&timer);
+    psort(parallel, n, threads, false);
+    double t_parallel = delta_time(&timer);
+
+    /* Both sorts are stable, so they have to agree element by element */
+    for (struct list_head *a = serial->next, *b = parallel->next;
+         ok && a != serial; a = a->next, b = b->next) {
+        ok = b != parallel && !strcmp(list_entry(a, element_t, list)->value,
+                                      list_entry(b, element_t, list)->value);
+    }
+    /* Sorted, the blocks are freed in random order: skip the search */
+    set_cautious_mode(false);
+    q_free(serial);
+    q_free(parallel);
+    set_cautious_mode(true);
+    if (!ok) {
+        report(1, "ERROR: Parallel sort differs from serial sort");
+        return false;
+    }
+
+    report(1, "Sort of %d random strings:", n);
+    report(1, "  serial     %8.3f s", t_serial);
+    report(1, "  %2d threads %8.3f s  speedup %.2fx", threads, t_parallel,
+           t_parallel > 0 ? t_serial / t_parallel : 0);
+    return true;
+}
+
+/* Free the queues of a chain built by bench_merge() */
+static void free_chain(queue_contex_t *ctx, int k)
+{
+    set_cautious_mode(false);
+    for (int i = 0; i < k; i++)
+        q_free(ctx[i].q);
+    set_cautious_mode(true);
+    free(ctx);
+}
+
+/* Build a chain of k sorted queues of per random strings each, and an
+ * identical second chain for the parallel merge.
+ */
+static bool build_chains(struct list_head *serial,
+                         struct list_head *parallel,
+                         queue_contex_t *a,
+                         queue_contex_t *b,
+                         int k,
+                         int per)
+{
+    char buf[BENCH_STRLEN + 1];
+
+    for (int i = 0; i < k; i++) {
+        a[i].q = q_new();
+        b[i].q = q_new();
+        a[i].id = b[i].id = i;
+        if (!a[i].q || !b[i].q)
+            return false;
+        list_add_tail(&a[i].chain, serial);
+        list_add_tail(&b[i].chain, parallel);
+
+        for (int j = 0; j < per; j++) {
+            random_string(buf);
+            if (!q_insert_tail(a[i].q, buf) || !q_insert_tail(b[i].q, buf))
+                return false;
+        }
+        q_sort(a[i].q, false);
+        q_sort(b[i].q, false);
+    }
+    return true;
+}
+
+bool bench_merge(int n, int threads)
+{
+    static const int ks[] = {2, 8, 32, 128, 512};
+
+    report(1, "Merge of %d random strings, %d threads:", n, threads);
+    report(1, "  %5s %9s %10s %10s %8s", "k", "per queue", "serial",
+           "parallel", "speedup");
+    for (size_t i = 0; i < sizeof(ks) / sizeof(ks[0]); i++) {
+        int k = ks[i], per = n / k;
+        if (!per)
+            break;
+
+        queue_contex_t *a = calloc(k, sizeof(*a));
+        queue_contex_t *b = calloc(k, sizeof(*b));
+        if (!a || !b) {
+            free(a);
+            free(b);
+            report(1, "ERROR: Could not build the queues to merge");
+            return false;
+        }
+
+        LIST_HEAD(serial);
+        LIST_HEAD(parallel);
+        if (!build_chains(&serial, &parallel, a, b, k, per)) {
+            free_chain(a, k);
+            free_chain(b, k);
+            report(1, "ERROR: Could not build the queues to merge");
+            return false;
+        }
+
+        double timer;
+        init_time(&timer);
+        q_merge(&serial, false);
+        double t_serial = delta_time(&timer);
+        pmerge(&parallel, threads, false);
+        double t_parallel = delta_time(&timer);
+
+        /* Both merges are stable, so they have to agree element by element */
+        bool ok = true;
+        for (struct list_head *x = a[0].q->next, *y = b[0].q->next;
+             ok && x != a[0].q; x = x->next, y = y->next) {
+            ok = y != b[0].q &&
+                 !strcmp(list_entry(x, element_t, list)->value,
+                         list_entry(y, element_t, list)->value);
+        }
+        ok = ok && q_size(a[0].q) == k * per && q_size(b[0].q) == k * per;
+
+        free_chain(a, k);
+        free_chain(b, k);
+        if (!ok) {
+            report(1, "ERROR: Parallel merge differs from serial merge");
+            return false;
+        }
+        report(1, "  %5d %9d %8.3f s %8.3f s %7.2fx", k, per, t_serial,
+               t_parallel, t_parallel > 0 ? t_serial / t_parallel : 0);
+    }
+    return true;
+}
+
+/* Latency histogram with 2^LAT_SUB buckets per power of two nanoseconds,
+ * which bounds the error of a reported percentile to 1 / 2^LAT_SUB.
+ */
+#define LAT_SUB 3
+#define LAT_BUCKETS (64 << LAT_SUB)
+
+typedef struct {
+    uint64_t count[LAT_BUCKETS];
+} lat_hist_t;
+
+static inline uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline void lat_record(lat_hist_t *h, uint64_t ns)
+{
+    int b = ns;
+    if (ns >= (1 << LAT_SUB)) {
+        int msb = 63 - __builtin_clzll(ns);
+        b = ((msb - LAT_SUB + 1) << LAT_SUB) +
+            ((ns >> (msb - LAT_SUB)) & ((1 << LAT_SUB) - 1));
+    }
+    h->count[b]++;
+}
+
+/* Upper bound of the values counted in bucket b */
+static uint64_t lat_bound(int b)
+{
+    if (b < (1 << LAT_SUB))
+        return b;
+    int shift = (b >> LAT_SUB) - 1;
+    uint64_t mant = (1 << LAT_SUB) + (b & ((1 << LAT_SUB) - 1));
+    return ((mant + 1) << shift) - 1;
+}
+
+static void lat_merge(lat_hist_t *dst, const lat_hist_t *src)
+{
+    for (int b = 0; b < LAT_BUCKETS; b++)
+        dst->count[b] += src->count[b];
+}
+
+/* Smallest bound which at least the fraction p of the samples is within */
+static uint64_t lat_percentile(const lat_hist_t *h, double p)
+{
+    uint64_t total = 0, seen = 0;
+    for (int b = 0; b < LAT_BUCKETS; b++)
+        total += h->count[b];
+
+    for (int b = 0; b < LAT_BUCKETS; b++) {
+        seen += h->count[b];
+        if (seen && seen >= p * total)
+            return lat_bound(b);
+    }
+    return 0;
+}
+
+static void report_latency(const char *op, const lat_hist_t *h)
+{
+    report(1, "  %-10s %8lu %8lu %8lu %8lu", op,
+           (unsigned long) lat_percentile(h, 0.5),
+           (unsigned long) lat_percentile(h, 0.99),
+           (unsigned long) lat_percentile(h, 0.999),
+           (unsigned long) lat_percentile(h, 1.0));
+}
+
+/* Most worker threads one benchmark run starts */
+#define BENCH_MAX_THREADS 64
+
+/**
+ * bench_sync_t - Start line of the worker threads of a benchmark run
+ * @start: set once every thread is created, so they all begin together
+ * @abort: set along with @start if a thread could not be created
+ */
+typedef struct {
+    atomic_bool start;
+    atomic_bool abort;
+} bench_sync_t;
+
+/* Run fn on count threads, thread i getting the argument at args + i * size,
+ * and time them from the moment they are released until all are joined.
+ * Return a negative time if a thread could not be created; the others are
+ * then told to give up as soon as they start.
+ */
+static double run_workers(void *(*fn)(void *),
+                          void *args,
+                          size_t size,
+                          int count,
+                          bench_sync_t *sync)
+{
+    pthread_t threads[BENCH_MAX_THREADS];
+    int spawned;
+
+    atomic_init(&sync->start, false);
+    atomic_init(&sync->abort, false);
+    for (spawned = 0; spawned < count; spawned++) {
+        if (pthread_create(&threads[spawned], NULL, fn,
+                           (char *) args + spawned * size))
+            break;
+    }
+
+    double timer;
+    init_time(&timer);
+    atomic_store(&sync->abort, spawned < count);
+    atomic_store(&sync->start, true);
+    for (int i = 0; i < spawned; i++)
+        pthread_join(threads[i], NULL);
+    double t = delta_time(&timer);
+    return spawned < count ? -1 : t;
+}
+
+/* Wait for run_workers() to release the threads, false if they give up */
+static bool wait_start(bench_sync_t *sync)
+{
+    while (!atomic_load(&sync->start))
+        sched_yield();
+    return !atomic_load(&sync->abort);
+}
+
+/* Check a value "i:seq" inserted by producer i against the last sequence
+ * number seen from it, which it has to exceed.
+ */
+static bool seq_in_order(int *last, const char *value)
+{
+    int id, seq;
+    if (sscanf(value, "%d:%d", &id, &seq) != 2 || id < 0 ||
+        id >= BENCH_MAX_THREADS || seq <= last[id])
+        return false;
+    last[id] = seq;
+    return true;
+}
+
+/**
+ * mpmc_worker_t - A producer or consumer of the MPMC benchmark
+ * @q: the queue
+ * @sync: start line of the run
+ * @consumed: elements removed by all consumers so far
+ * @id: index of a producer, -1 for a consumer
+ * @count: elements a producer inserts, or all of them for a consumer
+ * @ok: whether every operation succeeded and came in FIFO order
+ * @hist: latencies of the operations of this worker
+ *
+ * Producer i inserts the strings "i:0", "i:1" and so on, so a consumer can
+ * check that it sees the elements of every producer in increasing order.
+ */
+typedef struct {
+    mpmc_queue_t *q;
+    bench_sync_t *sync;
+    atomic_int *consumed;
+    int id;
+    int count;
+    bool ok;
+    lat_hist_t hist;
+} mpmc_worker_t;
+
+static void mpmc_produce(mpmc_worker_t *w, mq_thread_t *t)
+{
+    char buf[32];
+    for (int i = 0; w->ok && i < w->count; i++) {
+        snprintf(buf, sizeof(buf), "%d:%d", w->id, i);
+        uint64_t t0 = now_ns();
+        w->ok = mq_insert_tail(t, buf);
+        lat_record(&w->hist, now_ns() - t0);
+    }
+}
+
+static void mpmc_consume(mpmc_worker_t *w, mq_thread_t *t)
+{
+    int last[BENCH_MAX_THREADS];
+    for (int i = 0; i < BENCH_MAX_THREADS; i++)
+        last[i] = -1;
+
+    while (atomic_load(w->consumed) < w->count) {
+        uint64_t t0 = now_ns();
+        element_t *e = mq_remove_head(t, NULL, 0);
+        uint64_t t1 = now_ns();
+        if (!e) {
+            sched_yield();
+            continue;
+        }
+
+        lat_record(&w->hist, t1 - t0);
+        w->ok = seq_in_order(last, e->value) && w->ok;
+        element_free(e);
+        atomic_fetch_add(w->consumed, 1);
+    }
+}
+
+static void *mpmc_work(void *arg)
+{
+    mpmc_worker_t *w = arg;
+    mq_thread_t *t = mq_attach(w->q);
+    bool go = wait_start(w->sync);
+    if (!t) {
+        /* Let the consumers finish without the elements of this producer */
+        w->ok = false;
+        atomic_fetch_add(w->consumed, w->id >= 0 ? w->count : 0);
+        return NULL;
+    }
+
+    if (go && w->id >= 0)
+        mpmc_produce(w, t);
+    else if (go)
+        mpmc_consume(w, t);
+    mq_detach(t);
+    return NULL;
+}
+
+bool bench_mpmc(int producers, int consumers, int n)
+{
+    int nr = producers + consumers;
+    mpmc_queue_t *q = mq_new();
+    mpmc_worker_t *w = calloc(nr, sizeof(*w));
+    if (!q || !w) {
+        mq_free(q);
+        free(w);
+        report(1, "ERROR: Could not allocate the queue and workers");
+        return false;
+    }
+
+    bench_sync_t sync;
+    atomic_int consumed;
+    atomic_init(&consumed, 0);
+    for (int i = 0; i < nr; i++) {
+        w[i] = (mpmc_worker_t){
+            .q = q,
+            .sync = &sync,
+            .consumed = &consumed,
+            .id = i < producers ? i : -1,
+            .count = i < producers ? n / producers + (i < n % producers) : n,
+            .ok = true,
+        };
+    }
+    double t = run_workers(mpmc_work, w, sizeof(*w), nr, &sync);
+
+    bool ok = t >= 0 && atomic_load(&consumed) == n;
+    lat_hist_t insert = {0}, remove = {0};
+    for (int i = 0; i < nr; i++) {
+        ok = ok && w[i].ok;
+        lat_merge(i < producers ? &insert : &remove, &w[i].hist);
+    }
+    mq_free(q);
+    free(w);
+    if (!ok) {
+        report(1, "ERROR: MPMC queue lost, duplicated or reordered elements, "
+                  "or a thread could not be started");
+        return false;
+    }
+
+    report(1, "MPMC queue, %d producers, %d consumers, %d elements:",
+           producers, consumers, n);
+    report(1, "  elapsed    %8.3f s  %12.0f ops/sec", t, t > 0 ? 2 * n / t : 0);
+    report(1, "  %-10s %8s %8s %8s %8s  (ns)", "latency", "p50", "p99",
+           "p99.9", "max");
+    report_latency("insert", &insert);
+    report_latency("remove", &remove);
+    return true;
+}
+
+/* Elements in the deque before the mixed workload starts */
+#define CDQ_PREFILL 64
+
+/* Milliseconds a blocked consumer waits before giving up */
+#define CDQ_WAIT_MS 1000
+
+/**
+ * cdq_worker_t - A thread of the concurrent deque benchmark
+ * @q: the deque
+ * @sync: start line of the run
+ * @consumed: elements removed by all consumers of a handoff so far
+ * @id: index of the thread, -1 for a consumer of a handoff
+ * @count: operations of a mixed worker, elements a producer inserts, or all
+ *         of them for a consumer
+ * @ok: whether every operation succeeded and came in FIFO order
+ */
+typedef struct {
+    cdeque_t *q;
+    bench_sync_t *sync;
+    atomic_int *consumed;
+    int id;
+    int count;
+    bool ok;
+} cdq_worker_t;
+
+/* Alternate insertions at the tail with removals at the head. Each removal
+ * follows an insertion of the same thread, so the deque never runs dry.
+ */
+static void *cdq_mixed(void *arg)
+{
+    cdq_worker_t *w = arg;
+    if (!wait_start(w->sync))
+        return NULL;
+
+    for (int i = 0; w->ok && i < w->count / 2; i++) {
+        element_t *e = NULL;
+        w->ok = cdq_insert_tail(w->q, strings[i % BENCH_STRINGS]) &&
+                (e = cdq_remove_head(w->q, NULL, 0));
+        if (e)
+            element_free(e);
+    }
+    return NULL;
+}
+
+/* Producers insert at the tail, consumers block at the head until every
+ * element has arrived.
+ */
+static void *cdq_handoff(void *arg)
+{
+    cdq_worker_t *w = arg;
+    if (!wait_start(w->sync))
+        return NULL;
+
+    char buf[32];
+    if (w->id >= 0) {
+        for (int i = 0; w->ok && i < w->count; i++) {
+            snprintf(buf, sizeof(buf), "%d:%d", w->id, i);
+            w->ok = cdq_insert_tail(w->q, buf);
+        }
+        return NULL;
+    }
+
+    int last[BENCH_MAX_THREADS];
+    for (int i = 0; i < BENCH_MAX_THREADS; i++)
+        last[i] = -1;
+
+    /* Claim an element before waiting for it, so no consumer waits for one
+     * which another consumer is going to take.
+     */
+    while (w->ok && atomic_fetch_add(w->consumed, 1) < w->count) {
+        element_t *e = cdq_remove_head_wait(w->q, CDQ_WAIT_MS, NULL, 0);
+        w->ok = e && seq_in_order(last, e->value);
+        if (e)
+            element_free(e);
+    }
+    return NULL;
+}
+
+/* Time one run of the mixed workload on threads threads, negative if the
+ * run failed.
+ */
+static double cdq_run_mixed(int threads, int n, bool split)
+{
+    cdeque_t *q = cdq_new(split);
+    cdq_worker_t w[BENCH_MAX_THREADS];
+    bool ok = q;
+    for (int i = 0; ok && i < CDQ_PREFILL; i++)
+        ok = cdq_insert_tail(q, strings[i]);
+
+    bench_sync_t sync;
+    double t = -1;
+    if (ok) {
+        for (int i = 0; i < threads; i++) {
+            w[i] = (cdq_worker_t){
+                .q = q,
+                .sync = &sync,
+                .id = i,
+                .count = n / threads,
+                .ok = true,
+            };
+        }
+        t = run_workers(cdq_mixed, w, sizeof(w[0]), threads, &sync);
+        for (int i = 0; i < threads; i++)
+            ok = ok && w[i].ok;
+        ok = ok && cdq_size(q) == CDQ_PREFILL;
+    }
+    cdq_free(q);
+    return ok ? t : -1;
+}
+
+/* Time one handoff of n elements from producers to blocking consumers,
+ * negative if the run failed.
+ */
+static double cdq_run_handoff(int producers, int consumers, int n)
+{
+    cdeque_t *q = cdq_new(true);
+    if (!q)
+        return -1;
+
+    cdq_worker_t w[BENCH_MAX_THREADS];
+    bench_sync_t sync;
+    atomic_int consumed;
+    atomic_init(&consumed, 0);
+    for (int i = 0; i < producers + consumers; i++) {
+        w[i] = (cdq_worker_t){
+            .q = q,
+            .sync = &sync,
+            .consumed = &consumed,
+            .id = i < producers ? i : -1,
+            .count = i < producers ? n / producers + (i < n % producers) : n,
+            .ok = true,
+        };
+    }
+    double t = run_workers(cdq_handoff, w, sizeof(w[0]), producers + consumers,
+                           &sync);
+
+    bool ok = t >= 0 && !cdq_size(q);
+    for (int i = 0; i < producers + consumers; i++)
+        ok = ok && w[i].ok;
+    cdq_free(q);
+    return ok ? t : -1;
+}
+
+bool bench_cdeque(int n)
+{
+    static const int counts[] = {1, 2, 4, 8, 16, 32};
+
+    init_strings();
+    report(1, "Concurrent deque, %d operations per run (ops/sec):", n);
+    report(1, "  %7s %12s %12s %12s", "threads", "one lock", "two locks",
+           "handoff");
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        int threads = counts[i];
+        int producers = threads > 1 ? threads / 2 : 1;
+        int consumers = threads > 1 ? threads - producers : 1;
+
+        double t_one = cdq_run_mixed(threads, n, false);
+        double t_two = cdq_run_mixed(threads, n, true);
+        double t_handoff = cdq_run_handoff(producers, consumers, n / 2);
+        if (t_one < 0 || t_two < 0 || t_handoff < 0) {
+            report(1, "ERROR: Concurrent deque lost, duplicated or reordered "
+                      "elements, or a thread could not be started");
+            return false;
+        }
+
+        /* Every thread does its share rounded down to whole pairs, and a
+         * handoff moves n / 2 elements with two operations each.
+         */
+        double ops = n / threads / 2 * 2 * threads, handoff = n / 2 * 2;
+        report(1, "  %7d %12.0f %12.0f %12.0f", threads,
+               t_one > 0 ? ops / t_one : 0, t_two > 0 ? ops / t_two : 0,
+               t_handoff > 0 ? handoff / t_handoff : 0);
+    }
+    return true;
+}
+
+/* Ranges up to this long are summed up rather than split */
+#define FJ_GRAIN 256
+
+/**
+ * fj_worker_t - A thread of the fork-join benchmark
+ * @deques: the deques of all workers, this one owning deques[@id]
+ * @nr: number of workers
+ * @sync: start line of the run
+ * @pending: tasks pushed or running and not finished yet
+ * @id: index of the worker
+ * @seed: state of the generator picking victims to steal from
+ * @sum: sum of the leaves this worker finished
+ * @tasks: tasks this worker ran, whether popped or stolen
+ * @tries: steal attempts
+ * @steals: successful steal attempts
+ *
+ * A task is an element holding the range "lo:hi". Its owner keeps splitting
+ * off the upper half onto its own deque, where idle workers can steal it,
+ * until the rest is no longer than FJ_GRAIN and is summed up.
+ */
+typedef struct {
+    wsdeque_t **deques;
+    int nr;
+    bench_sync_t *sync;
+    atomic_long *pending;
+    int id;
+    uint32_t seed;
+    uint64_t sum;
+    long tasks;
+    long tries;
+    long steals;
+} fj_worker_t;
+
+/* Work of a leaf: hash every number of the range with splitmix64 */
+static uint64_t fj_leaf(long lo, long hi)
+{
+    uint64_t sum = 0;
+    for (long i = lo; i < hi; i++) {
+        uint64_t z = (uint64_t) i + 0x9e3779b97f4a7c15;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        sum += z ^ (z >> 31);
+    }
+    return sum;
+}
+
+/* Run a task, forking its upper halves off onto the deque of w */
+static void fj_run(fj_worker_t *w, element_t *e)
+{
+    wsdeque_t *own = w->deques[w->id];
+    long lo = 0, hi = 0;
+    sscanf(e->value, "%ld:%ld", &lo, &hi);
+    element_free(e);
+    w->tasks++;
+
+    char buf[48];
+    while (hi - lo > FJ_GRAIN) {
+        long mid = lo + (hi - lo) / 2;
+        snprintf(buf, sizeof(buf), "%ld:%ld", mid, hi);
+        atomic_fetch_add(w->pending, 1);
+        if (!wsq_push(own, buf)) {
+            /* Nowhere to fork to: do the upper half here as well */
+            atomic_fetch_sub(w->pending, 1);
+            break;
+        }
+        hi = mid;
+    }
+    w->sum += fj_leaf(lo, hi);
+    atomic_fetch_sub(w->pending, 1);
+}
+
+static void *fj_work(void *arg)
+{
+    fj_worker_t *w = arg;
+    if (!wait_start(w->sync))
+        return NULL;
+
+    while (atomic_load(w->pending)) {
+        element_t *e = wsq_pop(w->deques[w->id]);
+        if (!e && w->nr > 1) {
+            /* xorshift32 */
+            w->seed ^= w->seed << 13;
+            w->seed ^= w->seed >> 17;
+            w->seed ^= w->seed << 5;
+            int victim = w->seed % (w->nr - 1);
+            victim += victim >= w->id;
+
+            w->tries++;
+            e = wsq_steal(w->deques[victim]);
+            w->steals += !!e;
+        }
+        if (e)
+            fj_run(w, e);
+        else
+            sched_yield();
+    }
+    return NULL;
+}
+
+/* Sum up range n on threads workers, negative if the run failed */
+static double fj_run_threads(int threads, long n, uint64_t expect, long *stats)
+{
+    wsdeque_t *deques[BENCH_MAX_THREADS];
+    fj_worker_t w[BENCH_MAX_THREADS];
+    bench_sync_t sync;
+    atomic_long pending;
+    bool ok = true;
+
+    for (int i = 0; i < threads; i++) {
+        deques[i] = wsq_new();
+        ok = ok && deques[i];
+        w[i] = (fj_worker_t){
+            .deques = deques,
+            .nr = threads,
+            .sync = &sync,
+            .pending = &pending,
+            .id = i,
+            .seed = 2463534242u + i,
+        };
+    }
+
+    char root[48];
+    snprintf(root, sizeof(root), "0:%ld", n);
+    atomic_init(&pending, 1);
+    ok = ok && wsq_push(deques[0], root);
+
+    double t = -1;
+    if (ok)
+        t = run_workers(fj_work, w, sizeof(w[0]), threads, &sync);
+
+    uint64_t sum = 0;
+    stats[0] = stats[1] = stats[2] = 0;
+    for (int i = 0; i < threads; i++) {
+        sum += w[i].sum;
+        stats[0] += w[i].tasks;
+        stats[1] += w[i].tries;
+        stats[2] += w[i].steals;
+        wsq_free(deques[i]);
+    }
+    return ok && t >= 0 && sum == expect ? t : -1;
+}
+
+bool bench_forkjoin(long n)
+{
+    static const int counts[] = {1, 2, 4, 8, 16};
+
+    double timer;
+    init_time(&timer);
+    uint64_t expect = fj_leaf(0, n);
+    double t_serial = delta_time(&timer);
+
+    report(1, "Fork-join sum over %ld numbers, grain %d, serial %.3f s:", n,
+           FJ_GRAIN, t_serial);
+    report(1, "  %7s %9s %12s %9s %9s %9s %10s", "threads", "elapsed",
+           "tasks/sec", "tasks", "tries", "steals", "steal rate");
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        long stats[3];
+        double t = fj_run_threads(counts[i], n, expect, stats);
+        if (t < 0) {
+            report(1, "ERROR: Fork-join run on %d threads lost work, or a "
+                      "deque or thread could not be created",
+                   counts[i]);
+            return false;
+        }
+        report(1, "  %7d %7.3f s %12.0f %9ld %9ld %9ld %9.1f%%", counts[i],
+               t, t > 0 ? stats[0] / t : 0, stats[0], stats[1], stats[2],
+               stats[0] ? 100.0 * stats[2] / stats[0] : 0);
+    }
+    return true;
+}
+
+/* Most elements moved by one batch operation of the SPSC benchmark */
+#define SPSC_MAX_BATCH 256
+
+/**
+ * spsc_worker_t - The producer or the consumer of the SPSC benchmark
+ * @ch: the channel
+ * @sync: start line of the run
+ * @failed: set by the producer if it could not allocate an element
+ * @producer: whether this is the producer
+ * @count: messages to send or receive
+ * @batch: elements moved per operation, 1 for spsc_push() and spsc_pop()
+ * @hash: FNV-1a hash of every message sent or received so far, in order
+ * @bytes: characters sent or received so far
+ */
+typedef struct {
+    spsc_t *ch;
+    bench_sync_t *sync;
+    atomic_bool *failed;
+    bool producer;
+    int count;
+    int batch;
+    uint64_t hash;
+    uint64_t bytes;
+} spsc_worker_t;
+
+static inline uint64_t stream_hash(uint64_t h, const char *s)
+{
+    for (; *s; s++)
+        h = (h ^ (unsigned char) *s) * 0x100000001b3;
+    return h;
+}
+
+/* Fill buf with a string shaped like the RAND ones of qtest, 5 to 9 random
+ * lowercase letters, and return its length.
+ */
+static size_t stream_string(uint64_t *seed, char *buf)
+{
+    /* xorshift64 */
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 7;
+    *seed ^= *seed << 17;
+
+    uint64_t r = *seed;
+    size_t len = 5 + r % 5;
+    r /= 5;
+    for (size_t j = 0; j < len; j++, r /= 26)
+        buf[j] = 'a' + r % 26;
+    buf[len] = '\0';
+    return len;
+}
+
+static void spsc_produce(spsc_worker_t *w)
+{
+    element_t *v[SPSC_MAX_BATCH];
+    uint64_t seed = 88172645463325252ull;
+    char buf[16];
+
+    for (int sent = 0; sent < w->count;) {
+        int n = w->count - sent < w->batch ? w->count - sent : w->batch;
+        for (int i = 0; i < n; i++) {
+            w->bytes += stream_string(&seed, buf);
+            w->hash = stream_hash(w->hash, buf);
+            if (!(v[i] = element_alloc(buf))) {
+                while (i--)
+                    element_free(v[i]);
+                atomic_store(w->failed, true);
+                return;
+            }
+        }
+
+        for (int done = 0; done < n;) {
+            size_t k = w->batch > 1 ? spsc_push_batch(w->ch, v + done, n - done)
+                                    : spsc_push(w->ch, v[done]);
+            done += k;
+            if (!k)
+                sched_yield();
+        }
+        sent += n;
+    }
+}
+
+static void spsc_consume(spsc_worker_t *w)
+{
+    element_t *v[SPSC_MAX_BATCH];
+
+    for (int received = 0; received < w->count;) {
+        size_t n = 0;
+        if (w->batch > 1)
+            n = spsc_pop_batch(w->ch, v, w->batch);
+        else if ((v[0] = spsc_pop(w->ch)))
+            n = 1;
+        if (!n) {
+            if (atomic_load(w->failed))
+                return;
+            sched_yield();
+            continue;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            w->bytes += strlen(v[i]->value);
+            w->hash = stream_hash(w->hash, v[i]->value);
+            element_free(v[i]);
+        }
+        received += n;
+    }
+}
+
+static void *spsc_work(void *arg)
+{
+    spsc_worker_t *w = arg;
+    if (!wait_start(w->sync))
+        return NULL;
+
+    if (w->producer)
+        spsc_produce(w);
+    else
+        spsc_consume(w);
+    return NULL;
+}
+
+/* Stream n messages in batches of the given size, negative if the run
+ * failed.
+ */
+static double spsc_run(int n, int batch, uint64_t *bytes)
+{
+    spsc_t *ch = spsc_new(SPSC_CAPACITY);
+    if (!ch)
+        return -1;
+
+    spsc_worker_t w[2];
+    bench_sync_t sync;
+    atomic_bool failed;
+    atomic_init(&failed, false);
+    for (int i = 0; i < 2; i++) {
+        w[i] = (spsc_worker_t){
+            .ch = ch,
+            .sync = &sync,
+            .failed = &failed,
+            .producer = !i,
+            .count = n,
+            .batch = batch,
+            .hash = 0xcbf29ce484222325,
+        };
+    }
+    double t = run_workers(spsc_work, w, sizeof(w[0]), 2, &sync);
+
+    spsc_free(ch);
+    *bytes = w[1].bytes;
+    bool ok = t >= 0 && !atomic_load(&failed) && w[0].hash == w[1].hash &&
+              w[0].bytes == w[1].bytes;
+    return ok ? t : -1;
+}
+
+bool bench_spsc(int n)
+{
+    static const int batches[] = {1, 4, 16, 64, SPSC_MAX_BATCH};
+
+    report(1, "SPSC channel of capacity %d, %d RAND strings per run:",
+           SPSC_CAPACITY, n);
+    report(1, "  %7s %9s %12s %14s", "batch", "elapsed", "msgs/sec",
+           "bytes/sec");
+    for (size_t i = 0; i < sizeof(batches) / sizeof(batches[0]); i++) {
+        uint64_t bytes;
+        double t = spsc_run(n, batches[i], &bytes);
+        if (t < 0) {
+            report(1, "ERROR: SPSC channel lost, duplicated or reordered "
+                      "messages, or an element or thread could not be "
+                      "created");
+            return false;
+        }
+        report(1, "  %7d %7.3f s %12.0f %14.0f", batches[i], t,
+               t > 0 ? n / t : 0, t > 0 ? bytes / t : 0);
+    }
+    return true;
+}
+
+/* Bytes of the shared-memory queue of bench_shmq(), enough for a few
+ * thousand strings in flight
+ */
+#define SHMQ_BENCH_SIZE (1 << 20)
+
+/**
+ * xproc_result_t - What the consumer process of bench_shmq() received
+ * @count: strings received
+ * @bytes: bytes of the strings, without terminators
+ * @hash: FNV-1a chained over the strings in the order received
+ */
+typedef struct {
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t hash;
+} xproc_result_t;
+
+/* Milliseconds a process of bench_shmq() waits on the queue before checking
+ * that the other one is still there
+ */
+#define SHMQ_BENCH_POLL 100
+
+/* Consume the strings of the shared-memory queue name, in the child of
+ * parent
+ */
+static void shmq_consume(const char *name, pid_t parent, xproc_result_t *r)
+{
+    shmq_t *q = shmq_attach(name);
+    if (!q)
+        return;
+    for (;;) {
+        shmq_elem_t *e = shmq_remove_head(q, SHMQ_BENCH_POLL);
+        if (!e) {
+            /* Orphaned, no one will ever shut the queue down */
+            if (errno == ETIMEDOUT && getppid() == parent)
+                continue;
+            break;
+        }
+        r->count++;
+        r->bytes += e->len;
+        r->hash = stream_hash(r->hash, e->value);
+        shmq_release(q, e);
+    }
+    shmq_detach(q);
+}
+
+/* Insert s at the tail of q, waiting for room as long as the consumer
+ * process pid is alive
+ */
+static bool shmq_produce(shmq_t *q, const char *s, pid_t pid)
+{
+    while (!shmq_insert_tail(q, s, SHMQ_BENCH_POLL)) {
+        if (errno != ETIMEDOUT || waitpid(pid, NULL, WNOHANG))
+            return false;
+    }
+    return true;
+}
+
+/* Consume the strings coming through a pipe, each a length byte followed by
+ * as many characters, in the child
+ */
+static void pipe_consume(int fd, xproc_result_t *r)
+{
+    FILE *f = fdopen(fd, "r");
+    if (!f)
+        return;
+    char buf[256];
+    int len;
+    while ((len = getc(f)) != EOF && fread(buf, 1, len, f) == (size_t) len) {
+        buf[len] = '\0';
+        r->count++;
+        r->bytes += len;
+        r->hash = stream_hash(r->hash, buf);
+    }
+    fclose(f);
+}
+
+/* Produce n strings for the shared-memory queue q, or the pipe f if q is
+ * NULL, and check what the consumer process pid reports on the pipe fd,
+ * closing f and fd.
+ * Return the seconds taken until the consumer was done, or -1 if it lost,
+ * duplicated or reordered strings.
+ */
+static double xproc_produce(shmq_t *q,
+                            FILE *f,
+                            int n,
+                            pid_t pid,
+                            int fd,
+                            uint64_t *bytes)
+{
+    uint64_t seed = 88172645463325252ull, hash = 0xcbf29ce484222325;
+    char buf[16];
+    bool ok = true;
+    double timer;
+    init_time(&timer);
+    for (int i = 0; ok && i < n; i++) {
+        size_t len = stream_string(&seed, buf);
+        hash = stream_hash(hash, buf);
+        ok = q ? shmq_produce(q, buf, pid)
+               : putc(len, f) != EOF && fwrite(buf, 1, len, f) == len;
+    }
+    if (q)
+        shmq_shutdown(q);
+    else
+        ok = !fclose(f) && ok;
+
+    xproc_result_t r;
+    ok = read(fd, &r, sizeof(r)) == sizeof(r) && ok;
+    double t = delta_time(&timer);
+    waitpid(pid, NULL, 0);
+    close(fd);
+    *bytes = r.bytes;
+    return ok && r.count == (uint64_t) n && r.hash == hash ? t : -1;
+}
+
+/* Hand n strings to a child process through the shared-memory queue name if
+ * shm is set, or through a pipe otherwise, storing the bytes handed off.
+ * Return the seconds taken, or -1 on failure.
+ */
+static double xproc_run(const char *name, bool shm, int n, uint64_t *bytes)
+{
+    shmq_t *q = shm ? shmq_create(name, SHMQ_BENCH_SIZE) : NULL;
+    int data[2] = {-1, -1}, result[2];
+    if ((shm && !q) || (!shm && pipe(data)) || pipe(result)) {
+        shmq_detach(q);
+        if (q)
+            shmq_unlink(name);
+        return -1;
+    }
+
+    /* Anything buffered would otherwise be written by both processes */
+    fflush(NULL);
+    pid_t parent = getpid(), pid = fork();
+    if (!pid) {
+        xproc_result_t r = {.hash = 0xcbf29ce484222325};
+        close(result[0]);
+        if (shm) {
+            /* Attach by name, as an unrelated process would */
+            shmq_detach(q);
+            shmq_consume(name, parent, &r);
+        } else {
+            close(data[1]);
+            pipe_consume(data[0], &r);
+        }
+        ssize_t done = write(result[1], &r, sizeof(r));
+        _exit(done == sizeof(r) ? 0 : 1);
+    }
+    close(result[1]);
+    if (!shm)
+        close(data[0]);
+
+    double t = -1;
+    FILE *f = NULL;
+    if (pid > 0 && (shm || (f = fdopen(data[1], "w")))) {
+        t = xproc_produce(q, f, n, pid, result[0], bytes);
+    } else {
+        /* The child sees the end of its input and exits */
+        close(result[0]);
+        if (!shm)
+            close(data[1]);
+        if (pid > 0)
+            waitpid(pid, NULL, 0);
+    }
+    if (q) {
+        shmq_detach(q);
+        shmq_unlink(name);
+    }
+    return t;
+}
+
+bool bench_shmq(int n)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/lab0-shmq-%d", (int) getpid());
+
+    report(1, "Hand-off of %d RAND strings to another process:", n);
+    report(1, "  %-14s %9s %12s %14s", "through", "elapsed", "msgs/sec",
+           "bytes/sec");
+    for (int shm = 1; shm >= 0; shm--) {
+        uint64_t bytes = 0;
+        double t = xproc_run(name, shm, n, &bytes);
+        if (t < 0) {
+            report(1, "ERROR: Consumer process lost, duplicated or reordered "
+                      "strings, or the channel or process could not be "
+                      "created");
+            return false;
+        }
+        report(1, "  %-14s %7.3f s %12.0f %14.0f",
+               shm ? "shared memory" : "pipe", t, t > 0 ? n / t : 0,
+               t > 0 ? bytes / t : 0);
+    }
+    return true;
+}
+
+/**
+ * ext_check_t - Checker of the strings coming out of the external sort
+ * @descend: whether they have to come in descending order
+ * @prev: the string before
+ * @count: strings seen so far
+ * @hash: sum of the FNV-1a hashes of the strings seen so far
+ * @ok: whether every string came in order so far
+ */
+typedef struct {
+    bool descend;
+    char prev[16];
+    uint64_t count;
+    uint64_t hash;
+    bool ok;
+} ext_check_t;
+
+static bool ext_check(const char *s, size_t len, void *tag, void *arg)
+{
+    (void) tag;
+    ext_check_t *c = arg;
+    if (len >= sizeof(c->prev))
+        return c->ok = false;
+
+    int cmp = c->count ? strcmp(c->prev, s) : 0;
+    c->ok = c->descend ? cmp >= 0 : cmp <= 0;
+    memcpy(c->prev, s, len + 1);
+    c->count++;
+    c->hash += stream_hash(0xcbf29ce484222325, s);
+    return c->ok;
+}
+
+bool bench_extsort(int n, size_t budget, bool descend)
+{
+    extsort_t *s = extsort_new(budget, descend);
+    if (!s) {
+        report(1, "ERROR: Could not allocate the external sort");
+        return false;
+    }
+
+    uint64_t seed = 88172645463325252ull, hash = 0, bytes = 0;
+    char buf[16];
+    bool ok = true;
+    double timer;
+    init_time(&timer);
+    for (int i = 0; ok && i < n; i++) {
+        size_t len = stream_string(&seed, buf);
+        bytes += len;
+        hash += stream_hash(0xcbf29ce484222325, buf);
+        ok = extsort_add(s, buf, len, NULL);
+    }
+    double t_spill = delta_time(&timer);
+
+    ext_check_t check = {.descend = descend, .ok = true};
+    ok = ok && extsort_finish(s, ext_check, &check);
+    double t_merge = delta_time(&timer);
+
+    extsort_stats_t stats = *extsort_stats(s);
+    extsort_free(s);
+    if (!ok || check.count != (uint64_t) n || check.hash != hash) {
+        report(1, "ERROR: External sort lost, duplicated or misordered "
+                  "strings, or a temporary file could not be used");
+        return false;
+    }
+
+    report(1, "External sort of %d RAND strings (%.1f MiB), budget %zu KiB:",
+           n, bytes / 1048576.0, budget >> 10);
+    report(1, "  runs %lu, merge passes %lu, spilled %.1f MiB",
+           (unsigned long) stats.runs, (unsigned long) stats.passes,
+           stats.spilled / 1048576.0);
+    report(1, "  %-10s %8.3f s  %12.0f strings/sec", "spill", t_spill,
+           t_spill > 0 ? n / t_spill : 0);
+    report(1, "  %-10s %8.3f s  %12.0f strings/sec", "merge", t_merge,
+           t_merge > 0 ? n / t_merge : 0);
+    return true;
+}
+
+/* When a journal of bench_journal() commits its records */
+static const struct {
+    int batch;
+    long delay_us;
+} journal_configs[] = {
+    {1, 0}, {8, 0}, {64, 0}, {512, 0}, {4096, 0}, {0, 100}, {0, 1000},
+};
+
+/* Apply n operations to a queue, three insertions at the tail for every
+ * removal at the head, logging each to the journal j
+ */
+static bool journal_drive(struct list_head *q, journal_t *j, int n)
+{
+    uint64_t seed = 88172645463325252ull;
+    char buf[16];
+    for (int i = 0; i < n; i++) {
+        if (i % 4 == 3) {
+            element_t *e = q_remove_head(q, NULL, 0);
+            if (!e)
+                return false;
+            q_release_element(e);
+            if (!journal_log(j, JOURNAL_REMOVE_HEAD, 0, NULL))
+                return false;
+            continue;
+        }
+        stream_string(&seed, buf);
+        if (!q_insert_tail(q, buf) ||
+            !journal_log(j, JOURNAL_INSERT_TAIL, 0, buf))
+            return false;
+    }
+    return true;
+}
+
+/* Whether two queues hold the same strings in the same order */
+static bool queues_equal(struct list_head *a, struct list_head *b)
+{
+    struct list_head *x = a->next, *y = b->next;
+    for (; x != a && y != b; x = x->next, y = y->next) {
+        if (strcmp(list_entry(x, element_t, list)->value,
+                   list_entry(y, element_t, list)->value))
+            return false;
+    }
+    return x == a && y == b;
+}
+
+bool bench_journal(int n)
+{
+    const char *dir = getenv("TMPDIR");
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/lab0-journal-XXXXXX",
+             dir && *dir ? dir : "/tmp");
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        report(1, "ERROR: Could not create a journal in %s",
+               dir && *dir ? dir : "/tmp");
+        return false;
+    }
+    close(fd);
+
+    report(1, "Journal of %d operations, 3 insertions per removal:", n);
+    bool ok = true;
+    for (size_t i = 0;
+         ok && i < sizeof(journal_configs) / sizeof(journal_configs[0]); i++) {
+        int batch = journal_configs[i].batch;
+        long delay_us = journal_configs[i].delay_us;
+        struct list_head *q = q_new(), *replayed = q_new();
+        journal_t *j = NULL;
+        ok = q && replayed && !truncate(path, 0) &&
+             (j = journal_open(path, q, batch, delay_us));
+
+        /* Skip searching the heap for every element removed */
+        set_cautious_mode(false);
+        double timer;
+        init_time(&timer);
+        ok = ok && journal_drive(q, j, n) && journal_commit(j);
+        double t = delta_time(&timer);
+        journal_stats_t stats = j ? *journal_stats(j) : (journal_stats_t){0};
+        ok = journal_close(j) && ok;
+
+        /* Replaying the journal has to rebuild the same queue */
+        journal_t *r = ok ? journal_open(path, replayed, 0, 0) : NULL;
+        ok = r && journal_close(r) && queues_equal(q, replayed);
+
+        q_free(q);
+        q_free(replayed);
+        set_cautious_mode(true);
+        if (!ok)
+            break;
+
+        char label[32];
+        if (batch)
+            snprintf(label, sizeof(label), "batch %d", batch);
+        else
+            snprintf(label, sizeof(label), "every %ld us", delay_us);
+        report(1, "  %-14s %8.3f s  %10.0f ops/sec  %8lu fsyncs", label, t,
+               t > 0 ? n / t : 0, (unsigned long) stats.commits);
+    }
+
+    unlink(path);
+    if (!ok)
+        report(1, "ERROR: Journal could not be written or did not replay "
+                  "to the same queue");
+    return ok;
+}
+
+void bench_list()
+{
+    report_noreturn(1, "Available backends:");
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++)
+        report_noreturn(1, " %s", backends[i].name);
+    report(1, ", or sort, merge, journal");
+}
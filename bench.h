@@ -0,0 +1,101 @@
+#ifndef LAB0_BENCH_H
+#define LAB0_BENCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Throughput and memory benchmark for the queue backends.
+ *
+ * Each backend is driven through the same phases: filling it with n strings
+ * at the tail, walking over all of them, reversing, and draining it from the
+ * head. The time of every phase and the heap footprint per element are
+ * reported.
+ */
+
+/* Run the benchmark on the backend with the given name.
+ * Return false if there is no such backend or an operation failed.
+ */
+bool bench_run(const char *name, int n);
+
+/* Sort n random strings with q_sort() and with psort() on the given number
+ * of threads, check that both agree and report the speedup.
+ * Return false if building the queues failed or the results differ.
+ */
+bool bench_sort(int n, int threads);
+
+/* Merge n random strings, spread over chains of 2 up to 512 sorted queues,
+ * with q_merge() and with pmerge() on the given number of threads, check
+ * that both agree and report the speedup for every chain length.
+ * Return false if building the queues failed or the results differ.
+ */
+bool bench_merge(int n, int threads);
+
+/* Stream n elements through a lock-free MPMC queue of mpmc.h, inserted by
+ * the given number of producer threads and removed by as many consumers,
+ * check that no element is lost and that each consumer sees the elements of
+ * every producer in FIFO order, and report the throughput in operations per
+ * second along with the p50, p99, p99.9 and maximum latency of inserts and
+ * successful removes.
+ * Return false if a thread could not be started or the check failed.
+ */
+bool bench_mpmc(int producers, int consumers, int n);
+
+/* Drive the concurrent deque of cdeque.h with 1 to 32 threads, each doing
+ * n / threads operations alternating between inserts at the tail and
+ * removals at the head, once behind a single lock and once with a lock per
+ * end, and hand n / 2 elements from producer threads to consumers blocked
+ * in cdq_remove_head_wait(). Report the operations per second of each.
+ * Return false if a thread could not be started or elements were lost,
+ * duplicated or reordered.
+ */
+bool bench_cdeque(int n);
+
+/* Sum up a hash of the numbers below n as a fork-join computation over the
+ * work-stealing deques of wsdeque.h, on 1 to 16 threads. Every thread owns
+ * a deque, forks tasks onto it and steals from a random other deque when it
+ * runs dry. Report the throughput in tasks per second and how many of the
+ * tasks were stolen, and check the sum against a serial run.
+ * Return false if a deque or thread could not be created or the sum is off.
+ */
+bool bench_forkjoin(long n);
+
+/* Stream n strings shaped like the RAND ones of qtest from a producer thread
+ * to a consumer thread through the SPSC channel of spsc.h, once for each of
+ * several batch sizes, check that every message arrives intact and in order,
+ * and report the messages and bytes per second.
+ * Return false if an element or thread could not be created or the check
+ * failed.
+ */
+bool bench_spsc(int n);
+
+/* Stream n strings shaped like the RAND ones of qtest through the external
+ * merge sort of extsort.h with the given memory budget in bytes, check the
+ * order, count and contents of its output, and report the runs and bytes it
+ * spilled along with the time taken to add the strings and to merge them.
+ * Return false if a temporary file could not be used or the check failed.
+ */
+bool bench_extsort(int n, size_t budget, bool descend);
+
+/* Apply n insertions and removals to a queue, logging them to a journal of
+ * journal.h in a temporary file, once for each of several group sizes and
+ * commit delays, check that replaying the journal rebuilds the same queue,
+ * and report the operations per second and the number of fsyncs of each.
+ * Return false if the journal could not be written or replayed, or the
+ * check failed.
+ */
+bool bench_journal(int n);
+
+/* Hand n strings shaped like the RAND ones of qtest from this process to a
+ * forked one, first through a shared-memory queue of shmq.h which the child
+ * attaches by name and drains without copying, then through a pipe, check
+ * that every string arrives intact and in order, and report the strings and
+ * bytes per second of each.
+ * Return false if the queue, pipe or process could not be created or the
+ * check failed.
+ */
+bool bench_shmq(int n);
+
+/* Print the names of the available backends */
+void bench_list();
+
+#endif /* LAB0_BENCH_H */
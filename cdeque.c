@@ -0,0 +1,240 @@
+/* Concurrent deque with one lock per end */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Worker threads run this code, keep it off the harness like element.c */
+#define INTERNAL 1
+#include "harness.h"
+
+#include "cdeque.h"
+
+#define CDQ_CACHE_LINE 64
+
+/**
+ * struct cdeque - A concurrent deque
+ * @head_lock: lock of the head end, also guarding the wait for elements
+ * @nonempty: signalled when an element is inserted while someone waits
+ * @waiters: number of threads blocked in cdq_remove_head_wait()
+ * @tail_lock: lock of the tail end
+ * @split: whether the ends have separate locks, else @head_lock is the only
+ *         one ever taken
+ * @size: elements in @list, less the ones reserved for removal
+ * @list: head of the circular doubly-linked list of element_t
+ *
+ * Each lock starts a cache line of its own, so the two ends do not slow each
+ * other down by writing to the same line.
+ */
+struct cdeque {
+    pthread_mutex_t head_lock __attribute__((aligned(CDQ_CACHE_LINE)));
+    pthread_cond_t nonempty;
+    atomic_int waiters;
+    pthread_mutex_t tail_lock __attribute__((aligned(CDQ_CACHE_LINE)));
+    bool split;
+    atomic_int size __attribute__((aligned(CDQ_CACHE_LINE)));
+    struct list_head list;
+};
+
+cdeque_t *cdq_new(bool split)
+{
+    cdeque_t *q = aligned_alloc(CDQ_CACHE_LINE, sizeof(cdeque_t));
+    if (!q)
+        return NULL;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&q->nonempty, &attr);
+    pthread_condattr_destroy(&attr);
+
+    pthread_mutex_init(&q->head_lock, NULL);
+    pthread_mutex_init(&q->tail_lock, NULL);
+    atomic_init(&q->waiters, 0);
+    q->split = split;
+    atomic_init(&q->size, 0);
+    INIT_LIST_HEAD(&q->list);
+    return q;
+}
+
+void cdq_free(cdeque_t *q)
+{
+    if (!q)
+        return;
+
+    element_t *entry = NULL, *safe = NULL;
+    list_for_each_entry_safe (entry, safe, &q->list, list)
+        element_free(entry);
+    pthread_cond_destroy(&q->nonempty);
+    pthread_mutex_destroy(&q->head_lock);
+    pthread_mutex_destroy(&q->tail_lock);
+    free(q);
+}
+
+/* The lock an operation at one end of the deque starts with */
+static inline pthread_mutex_t *lock_of(cdeque_t *q, bool front)
+{
+    return front || !q->split ? &q->head_lock : &q->tail_lock;
+}
+
+/* The locks of both ends, always head first */
+static void lock_both(cdeque_t *q)
+{
+    pthread_mutex_lock(&q->head_lock);
+    pthread_mutex_lock(&q->tail_lock);
+}
+
+static void unlock_both(cdeque_t *q)
+{
+    pthread_mutex_unlock(&q->tail_lock);
+    pthread_mutex_unlock(&q->head_lock);
+}
+
+static inline void link_end(cdeque_t *q, element_t *e, bool front)
+{
+    if (front)
+        list_add(&e->list, &q->list);
+    else
+        list_add_tail(&e->list, &q->list);
+}
+
+static bool cdq_insert(cdeque_t *q, const char *s, bool front)
+{
+    element_t *e = element_alloc(s);
+    if (!e)
+        return false;
+
+    pthread_mutex_t *own = lock_of(q, front);
+    pthread_mutex_lock(own);
+    if (!q->split || atomic_load(&q->size) >= CDQ_SPLIT_MIN) {
+        link_end(q, e, front);
+        atomic_fetch_add(&q->size, 1);
+        pthread_mutex_unlock(own);
+    } else {
+        pthread_mutex_unlock(own);
+        lock_both(q);
+        link_end(q, e, front);
+        atomic_fetch_add(&q->size, 1);
+        unlock_both(q);
+    }
+
+    /* A waiter counts itself before checking the size under the head lock,
+     * and this reads the count after raising the size, so either it sees
+     * the element or it is signalled once blocked.
+     */
+    if (atomic_load(&q->waiters)) {
+        pthread_mutex_lock(&q->head_lock);
+        pthread_cond_signal(&q->nonempty);
+        pthread_mutex_unlock(&q->head_lock);
+    }
+    return true;
+}
+
+bool cdq_insert_head(cdeque_t *q, const char *s)
+{
+    return cdq_insert(q, s, true);
+}
+
+bool cdq_insert_tail(cdeque_t *q, const char *s)
+{
+    return cdq_insert(q, s, false);
+}
+
+/* Reserve an element for removal if there are at least min of them */
+static bool reserve(cdeque_t *q, int min)
+{
+    int n = atomic_load(&q->size);
+    while (n >= min) {
+        if (atomic_compare_exchange_weak(&q->size, &n, n - 1))
+            return true;
+    }
+    return false;
+}
+
+static element_t *cdq_remove(cdeque_t *q, char *sp, size_t bufsize, bool front)
+{
+    struct list_head *node = NULL;
+
+    pthread_mutex_t *own = lock_of(q, front);
+    pthread_mutex_lock(own);
+    if (reserve(q, q->split ? CDQ_SPLIT_MIN : 1)) {
+        node = front ? q->list.next : q->list.prev;
+        list_del(node);
+        pthread_mutex_unlock(own);
+    } else if (!q->split) {
+        pthread_mutex_unlock(own);
+    } else {
+        pthread_mutex_unlock(own);
+        lock_both(q);
+        if (atomic_load(&q->size)) {
+            atomic_fetch_sub(&q->size, 1);
+            node = front ? q->list.next : q->list.prev;
+            list_del(node);
+        }
+        unlock_both(q);
+    }
+    if (!node)
+        return NULL;
+
+    element_t *e = list_entry(node, element_t, list);
+    if (sp) {
+        strncpy(sp, e->value, bufsize);
+        sp[bufsize - 1] = '\0';
+    }
+    return e;
+}
+
+element_t *cdq_remove_head(cdeque_t *q, char *sp, size_t bufsize)
+{
+    return cdq_remove(q, sp, bufsize, true);
+}
+
+element_t *cdq_remove_tail(cdeque_t *q, char *sp, size_t bufsize)
+{
+    return cdq_remove(q, sp, bufsize, false);
+}
+
+element_t *cdq_remove_head_wait(cdeque_t *q,
+                                int timeout_ms,
+                                char *sp,
+                                size_t bufsize)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    if (timeout_ms > 0) {
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long) (timeout_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    /* Another consumer may take the element this one was woken up for */
+    bool timed_out = !timeout_ms;
+    for (;;) {
+        element_t *e = cdq_remove_head(q, sp, bufsize);
+        if (e || timed_out)
+            return e;
+
+        pthread_mutex_lock(&q->head_lock);
+        atomic_fetch_add(&q->waiters, 1);
+        while (!atomic_load(&q->size) && !timed_out) {
+            if (timeout_ms < 0)
+                pthread_cond_wait(&q->nonempty, &q->head_lock);
+            else
+                timed_out = pthread_cond_timedwait(&q->nonempty, &q->head_lock,
+                                                   &deadline) == ETIMEDOUT;
+        }
+        atomic_fetch_sub(&q->waiters, 1);
+        pthread_mutex_unlock(&q->head_lock);
+    }
+}
+
+int cdq_size(cdeque_t *q)
+{
+    return atomic_load(&q->size);
+}
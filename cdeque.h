@@ -0,0 +1,75 @@
+#ifndef LAB0_CDEQUE_H
+#define LAB0_CDEQUE_H
+
+/* Concurrent deque with one lock per end.
+ *
+ * The elements are element_t linked into a circular doubly-linked list, as
+ * in queue.h, but any number of threads may work on both ends at once. The
+ * head and the tail each have a lock of their own. While the deque holds at
+ * least CDQ_SPLIT_MIN elements, an operation at one end only ever touches
+ * nodes the other end cannot reach, so it takes the lock of its own end
+ * alone and runs in parallel with the other end. Shorter deques are worked
+ * on under both locks, always taken head first.
+ *
+ * A removal reserves its element by decrementing the size before touching
+ * the list, and an insertion only counts its element once it is linked. The
+ * size an end reads under its lock is thus never more than the elements it
+ * may use.
+ *
+ * cdq_remove_head_wait() blocks on a condition variable until an element
+ * arrives or the timeout expires. Elements come from element_alloc().
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "element.h"
+
+/* Shortest deque whose ends are worked on under separate locks */
+#define CDQ_SPLIT_MIN 3
+
+typedef struct cdeque cdeque_t;
+
+/* Create an empty deque, NULL for allocation failed.
+ * Unless split is set, every operation takes the head lock alone, which
+ * serializes them like a deque behind a single mutex would.
+ */
+cdeque_t *cdq_new(bool split);
+
+/* Free the deque and every element left in it, no effect if q is NULL.
+ * No thread may be using the deque any more.
+ */
+void cdq_free(cdeque_t *q);
+
+/* Insert an element holding a copy of s at head/tail of deque, waking up a
+ * thread blocked in cdq_remove_head_wait().
+ * Return false for allocation failed.
+ */
+bool cdq_insert_head(cdeque_t *q, const char *s);
+bool cdq_insert_tail(cdeque_t *q, const char *s);
+
+/* Remove the element at head/tail of deque, like q_remove_head(): if sp is
+ * non-NULL, its string is copied to it, with at most bufsize - 1 characters
+ * plus a null terminator. The caller releases the element with
+ * element_free().
+ * Return NULL if the deque is empty.
+ */
+element_t *cdq_remove_head(cdeque_t *q, char *sp, size_t bufsize);
+element_t *cdq_remove_tail(cdeque_t *q, char *sp, size_t bufsize);
+
+/* Like cdq_remove_head(), but wait for an element to arrive if the deque is
+ * empty: for up to timeout_ms milliseconds, or without limit if timeout_ms
+ * is negative.
+ * Return NULL if the deque is still empty when the timeout expires.
+ */
+element_t *cdq_remove_head_wait(cdeque_t *q,
+                                int timeout_ms,
+                                char *sp,
+                                size_t bufsize);
+
+/* Return the number of elements in deque, which may be outdated as soon as
+ * it is read.
+ */
+int cdq_size(cdeque_t *q);
+
+#endif /* LAB0_CDEQUE_H */
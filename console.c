@@ -64,6 +64,7 @@ static bool has_infile = false;
 #define MAXQUIT 10
 static cmd_func_t quit_helpers[MAXQUIT];
 static int quit_helper_cnt = 0;
+static line_idle_callback_t *idle_helper = NULL;
 
 static void init_in();
 
@@ -215,6 +216,12 @@ void add_quit_helper(cmd_func_t qf)
         report_event(MSG_FATAL, "Exceeded limit on quit helpers");
 }
 
+void set_idle_helper(line_idle_callback_t *fn)
+{
+    idle_helper = fn;
+    line_set_idle_callback(fn);
+}
+
 /* Turn echoing on/off */
 void set_echo(bool on)
 {
@@ -484,6 +491,23 @@ static void init_in()
     buf_stack = NULL;
 }
 
+/* Wait for input on fd, calling the idle helper whenever it asks to */
+static void wait_input(int fd)
+{
+    for (;;) {
+        int ms = idle_helper();
+        if (ms < 0)
+            return;
+
+        fd_set set;
+        FD_ZERO(&set);
+        FD_SET(fd, &set);
+        struct timeval tv = {.tv_sec = ms / 1000, .tv_usec = ms % 1000 * 1000};
+        if (select(fd + 1, &set, NULL, NULL, &tv))
+            return;
+    }
+}
+
 /* Read command from input file.
  * When hit EOF, close that file and return NULL
  */
@@ -498,6 +522,8 @@ static char *readline()
     for (int cnt = 0; cnt < RIO_BUFSIZE - 2; cnt++) {
         if (buf_stack->count <= 0) {
             /* Need to read from input file */
+            if (idle_helper)
+                wait_input(buf_stack->fd);
             buf_stack->count = read(buf_stack->fd, buf_stack->buf, RIO_BUFSIZE);
             buf_stack->bufptr = buf_stack->buf;
             if (buf_stack->count <= 0) {
@@ -56,6 +56,11 @@ bool get_int(char *vname, int *loc);
 /* Add function to be executed as part of program exit */
 void add_quit_helper(cmd_func_t qf);
 
+/* Set function to be called while waiting for a command, returning the
+ * milliseconds until it wants to be called again, or -1 to wait for input
+ */
+void set_idle_helper(line_idle_callback_t *fn);
+
 /* Turn echoing on/off */
 void set_echo(bool on);
 
@@ -6,6 +6,7 @@
 #include "cpucycles.h"
 #include "queue.h"
 #include "random.h"
+#include "ring.h"
 
 /* Maintain a queue independent from the qtest since
  * we do not want the test to affect the original functionality
@@ -36,6 +37,20 @@ static struct list_head *l = NULL;
 
 #define dut_free() ((void) (q_free(l)))
 
+/* The ring-buffer deque is measured through the same steps */
+static ring_queue_t *rq = NULL;
+
+#define dut_ring_new() ((void) (rq = rq_new()))
+
+#define dut_ring_insert_head(s, n) \
+    do {                           \
+        int j = n;                 \
+        while (j--)                \
+            rq_insert_head(rq, s); \
+    } while (0)
+
+#define dut_ring_free() ((void) (rq_free(rq)))
+
 static char random_string[N_MEASURES][8];
 static int random_string_iter = 0;
 
@@ -43,6 +58,7 @@ static int random_string_iter = 0;
 void init_dut(void)
 {
     l = NULL;
+    rq = NULL;
 }
 
 static char *get_random_string(void)
@@ -73,7 +89,9 @@ bool measure(int64_t *before_ticks,
              int mode)
 {
     assert(mode == DUT(insert_head) || mode == DUT(insert_tail) ||
-           mode == DUT(remove_head) || mode == DUT(remove_tail));
+           mode == DUT(remove_head) || mode == DUT(remove_tail) ||
+           mode == DUT(ring_insert_head) || mode == DUT(ring_insert_tail) ||
+           mode == DUT(ring_remove_head) || mode == DUT(ring_remove_tail));
 
     switch (mode) {
     case DUT(insert_head):
@@ -146,6 +164,47 @@ bool measure(int64_t *before_ticks,
                 return false;
         }
         break;
+    case DUT(ring_insert_head):
+    case DUT(ring_insert_tail):
+        for (size_t i = DROP_SIZE; i < N_MEASURES - DROP_SIZE; i++) {
+            char *s = get_random_string();
+            dut_ring_new();
+            dut_ring_insert_head(
+                get_random_string(),
+                *(uint16_t *) (input_data + i * CHUNK_SIZE) % 10000);
+            int before_size = rq_size(rq);
+            before_ticks[i] = cpucycles();
+            if (mode == DUT(ring_insert_head))
+                rq_insert_head(rq, s);
+            else
+                rq_insert_tail(rq, s);
+            after_ticks[i] = cpucycles();
+            int after_size = rq_size(rq);
+            dut_ring_free();
+            if (before_size != after_size - 1)
+                return false;
+        }
+        break;
+    case DUT(ring_remove_head):
+    case DUT(ring_remove_tail):
+        for (size_t i = DROP_SIZE; i < N_MEASURES - DROP_SIZE; i++) {
+            dut_ring_new();
+            dut_ring_insert_head(
+                get_random_string(),
+                *(uint16_t *) (input_data + i * CHUNK_SIZE) % 10000 + 1);
+            int before_size = rq_size(rq);
+            before_ticks[i] = cpucycles();
+            if (mode == DUT(ring_remove_head))
+                rq_remove_head(rq, NULL, 0);
+            else
+                rq_remove_tail(rq, NULL, 0);
+            after_ticks[i] = cpucycles();
+            int after_size = rq_size(rq);
+            dut_ring_free();
+            if (before_size != after_size + 1)
+                return false;
+        }
+        break;
     default:
         for (size_t i = DROP_SIZE; i < N_MEASURES - DROP_SIZE; i++) {
             dut_new();
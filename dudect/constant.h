@@ -12,11 +12,15 @@
 
 #define DROP_SIZE 20
 
-#define DUT_FUNCS  \
-    _(insert_head) \
-    _(insert_tail) \
-    _(remove_head) \
-    _(remove_tail)
+#define DUT_FUNCS       \
+    _(insert_head)      \
+    _(insert_tail)      \
+    _(remove_head)      \
+    _(remove_tail)      \
+    _(ring_insert_head) \
+    _(ring_insert_tail) \
+    _(ring_remove_head) \
+    _(ring_remove_tail)
 
 #define DUT(x) DUT_##x
 
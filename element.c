@@ -0,0 +1,26 @@
+/* Elements of the concurrent queues, off the harness */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Worker threads cannot go through the harness, which is not thread-safe */
+#define INTERNAL 1
+#include "harness.h"
+
+#include "element.h"
+
+element_t *element_alloc(const char *s)
+{
+    size_t len = strlen(s) + 1;
+    element_t *e = malloc(sizeof(element_t) + len);
+    if (!e)
+        return NULL;
+
+    e->value = memcpy(e->data, s, len);
+    return e;
+}
+
+void element_free(element_t *e)
+{
+    free(e);
+}
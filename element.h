@@ -0,0 +1,21 @@
+#ifndef LAB0_ELEMENT_H
+#define LAB0_ELEMENT_H
+
+/* Elements of the concurrent queues.
+ *
+ * The MPMC queue, the concurrent deque, the work-stealing deque and the SPSC
+ * channel carry element_t values which worker threads allocate and release.
+ * Those cannot go through the harness, which is not thread-safe, so they come
+ * from here instead: allocated with the regular malloc/free, each holding its
+ * string in its inline storage.
+ */
+
+#include "queue.h"
+
+/* Allocate an element holding a copy of s, NULL for allocation failed */
+element_t *element_alloc(const char *s);
+
+/* Release an element from element_alloc(), no effect if e is NULL */
+void element_free(element_t *e);
+
+#endif /* LAB0_ELEMENT_H */
@@ -0,0 +1,702 @@
+/* External merge sort of strings under a memory budget */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "extsort.h"
+#include "queue.h"
+
+/* Size of the first chunk, which grows up to the budget as needed */
+#define CHUNK_MIN 65536
+
+/* Size of the buffer runs are written through */
+#define IO_BUF 65536
+
+/* Smallest buffer a run is read through */
+#define IO_MIN 4096
+
+/* Ranges of fewer strings than this are sorted by insertion instead */
+#define RADIX_CUTOFF 32
+
+/* Deepest byte position distributed into buckets, bounding the stack usage */
+#define RADIX_MAX_DEPTH 64
+
+/**
+ * ext_run_t - A sorted run in a temporary file
+ * @fd: descriptor of the unlinked file
+ */
+typedef struct {
+    int fd;
+} ext_run_t;
+
+/**
+ * ext_key_t - A string in the chunk
+ * @prefix: the first 8 bytes of the string, big-endian and zero-padded, so
+ *          comparing prefixes as integers compares the strings up to there
+ * @str: the string
+ * @tag: what the caller attached to the string
+ *
+ * Sorting mostly looks at @prefix, which sits in the array being sorted,
+ * rather than at strings scattered over the whole chunk.
+ */
+typedef struct {
+    uint64_t prefix;
+    char *str;
+    void *tag;
+} ext_key_t;
+
+/**
+ * struct extsort - An external merge sort
+ * @budget: most bytes held in @chunk
+ * @descend: whether or not to sort in descending order
+ * @chunk: strings from the start, an ext_key_t for each from the end
+ * @cap: size of @chunk, a multiple of the pointer size
+ * @used: bytes of strings in @chunk
+ * @n: keys in @chunk
+ * @io: buffer runs are written through
+ * @runs: the runs spilled so far, in the order they were written
+ * @nr_runs: number of @runs
+ * @runs_cap: capacity of @runs
+ * @stats: what the sort had to do so far
+ */
+struct extsort {
+    size_t budget;
+    bool descend;
+    char *chunk;
+    size_t cap;
+    size_t used;
+    size_t n;
+    char *io;
+    ext_run_t *runs;
+    size_t nr_runs;
+    size_t runs_cap;
+    extsort_stats_t stats;
+};
+
+extsort_t *extsort_new(size_t budget, bool descend)
+{
+    extsort_t *s = malloc(sizeof(extsort_t));
+    if (!s)
+        return NULL;
+
+    if (budget < EXTSORT_BUDGET_MIN)
+        budget = EXTSORT_BUDGET_MIN;
+    *s = (extsort_t){
+        .budget = budget & ~(sizeof(char *) - 1),
+        .descend = descend,
+    };
+    return s;
+}
+
+void extsort_free(extsort_t *s)
+{
+    if (!s)
+        return;
+
+    for (size_t i = 0; i < s->nr_runs; i++)
+        close(s->runs[i].fd);
+    free(s->runs);
+    free(s->io);
+    free(s->chunk);
+    free(s);
+}
+
+const extsort_stats_t *extsort_stats(const extsort_t *s)
+{
+    return &s->stats;
+}
+
+static inline ext_key_t *chunk_keys(extsort_t *s)
+{
+    return (ext_key_t *) (s->chunk + s->cap) - s->n;
+}
+
+static inline size_t chunk_room(extsort_t *s)
+{
+    return s->cap - s->used - s->n * sizeof(ext_key_t);
+}
+
+/* Move the chunk into one of at least need more bytes, up to the budget */
+static bool chunk_grow(extsort_t *s, size_t need)
+{
+    size_t cap = s->cap ? 2 * s->cap : CHUNK_MIN;
+    while (cap < s->cap + need)
+        cap *= 2;
+    if (cap > s->budget)
+        cap = s->budget;
+    if (cap <= s->cap)
+        return false;
+
+    char *chunk = malloc(cap);
+    if (!chunk)
+        return false;
+
+    ext_key_t *from = chunk_keys(s);
+    ext_key_t *to = (ext_key_t *) (chunk + cap) - s->n;
+    if (s->used)
+        memcpy(chunk, s->chunk, s->used);
+    for (size_t i = 0; i < s->n; i++) {
+        to[i] = from[i];
+        to[i].str = chunk + (from[i].str - s->chunk);
+    }
+    free(s->chunk);
+    s->chunk = chunk;
+    s->cap = cap;
+    return true;
+}
+
+/* Compare two keys from depth on */
+static inline int key_cmp(const ext_key_t *a, const ext_key_t *b, size_t depth)
+{
+    if (a->prefix != b->prefix)
+        return a->prefix < b->prefix ? -1 : 1;
+    return strcmp(a->str + depth, b->str + depth);
+}
+
+static int cmp_ascend(const void *a, const void *b)
+{
+    return key_cmp(a, b, 0);
+}
+
+static int cmp_descend(const void *a, const void *b)
+{
+    return key_cmp(b, a, 0);
+}
+
+/* The byte of a key at depth, 0 past its end */
+static inline int key_byte(const ext_key_t *k, size_t depth)
+{
+    if (depth < 8)
+        return (k->prefix >> (56 - 8 * depth)) & 0xff;
+    return (unsigned char) k->str[depth];
+}
+
+/* Insertion sort of n keys comparing them from depth on */
+static void insertion_sort(ext_key_t *a, size_t n, size_t depth, bool descend)
+{
+    for (size_t i = 1; i < n; i++) {
+        ext_key_t k = a[i];
+        size_t j = i;
+        for (; j; j--) {
+            int cmp = key_cmp(&a[j - 1], &k, depth);
+            if (descend ? cmp >= 0 : cmp <= 0)
+                break;
+            a[j] = a[j - 1];
+        }
+        a[j] = k;
+    }
+}
+
+/* In-place MSD radix sort, the American flag sort, of n keys which share
+ * their first depth bytes. Each pass counts the keys per byte at depth, then
+ * swaps every key into the range of its bucket.
+ */
+static void flag_sort(ext_key_t *a, size_t n, size_t depth, bool descend)
+{
+    if (n < RADIX_CUTOFF) {
+        insertion_sort(a, n, depth, descend);
+        return;
+    }
+    if (depth >= RADIX_MAX_DEPTH) {
+        qsort(a, n, sizeof(ext_key_t), descend ? cmp_descend : cmp_ascend);
+        return;
+    }
+
+    /* Descending order takes the buckets from byte 255 down to the end */
+    size_t count[256] = {0}, next[256], end[256];
+    int flip = descend ? 255 : 0;
+    for (size_t i = 0; i < n; i++)
+        count[key_byte(&a[i], depth) ^ flip]++;
+    for (size_t b = 0, sum = 0; b < 256; b++) {
+        next[b] = sum;
+        sum += count[b];
+        end[b] = sum;
+    }
+
+    for (int b = 0; b < 256; b++) {
+        while (next[b] < end[b]) {
+            ext_key_t k = a[next[b]];
+            int c;
+            while ((c = key_byte(&k, depth) ^ flip) != b) {
+                ext_key_t tmp = a[next[c]];
+                a[next[c]++] = k;
+                k = tmp;
+            }
+            a[next[b]++] = k;
+        }
+    }
+
+    /* The keys which end at depth are all equal */
+    size_t start = 0;
+    for (int b = 0; b < 256; start += count[b++]) {
+        if (count[b] > 1 && (b ^ flip))
+            flag_sort(a + start, count[b], depth + 1, descend);
+    }
+}
+
+static void chunk_sort(extsort_t *s)
+{
+    flag_sort(chunk_keys(s), s->n, 0, s->descend);
+}
+
+/* Create an unlinked temporary file, -1 on failure */
+static int temp_open(void)
+{
+    const char *dir = getenv("TMPDIR");
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/lab0-extsort-XXXXXX",
+             dir && *dir ? dir : "/tmp");
+
+    int fd = mkstemp(path);
+    if (fd >= 0)
+        unlink(path);
+    return fd;
+}
+
+/**
+ * ext_writer_t - Buffered writer of a run
+ * @run: the run being written
+ * @buf: the buffer
+ * @len: bytes waiting in @buf
+ * @stats: statistics charged with the bytes written
+ * @ok: whether every write succeeded so far
+ */
+typedef struct {
+    ext_run_t run;
+    char *buf;
+    size_t len;
+    extsort_stats_t *stats;
+    bool ok;
+} ext_writer_t;
+
+static void writer_flush(ext_writer_t *w)
+{
+    for (size_t off = 0; w->ok && off < w->len;) {
+        ssize_t n = write(w->run.fd, w->buf + off, w->len - off);
+        if (n < 0 && errno != EINTR)
+            w->ok = false;
+        else if (n > 0)
+            off += n;
+    }
+    w->stats->spilled += w->len;
+    w->len = 0;
+}
+
+static void writer_put(ext_writer_t *w, const char *p, size_t len)
+{
+    while (len) {
+        if (w->len == IO_BUF)
+            writer_flush(w);
+        size_t n = IO_BUF - w->len < len ? IO_BUF - w->len : len;
+        memcpy(w->buf + w->len, p, n);
+        w->len += n;
+        p += n;
+        len -= n;
+    }
+}
+
+static void writer_varint(ext_writer_t *w, uint64_t v)
+{
+    char varint[10];
+    int n = 0;
+    do {
+        varint[n++] = (v & 0x7f) | (v > 0x7f ? 0x80 : 0);
+        v >>= 7;
+    } while (v);
+    writer_put(w, varint, n);
+}
+
+static bool writer_record(const char *str, size_t len, void *tag, void *arg)
+{
+    ext_writer_t *w = arg;
+    writer_varint(w, len);
+    writer_put(w, str, len);
+    writer_varint(w, (uintptr_t) tag);
+    return w->ok;
+}
+
+/* Start a run in a new temporary file, leaving nothing to clean up if that
+ * fails.
+ */
+static bool writer_open(extsort_t *s, ext_writer_t *w)
+{
+    if (!s->io && !(s->io = malloc(IO_BUF)))
+        return false;
+
+    if (s->nr_runs == s->runs_cap) {
+        size_t cap = s->runs_cap ? 2 * s->runs_cap : 16;
+        ext_run_t *runs = malloc(cap * sizeof(ext_run_t));
+        if (!runs)
+            return false;
+        if (s->nr_runs)
+            memcpy(runs, s->runs, s->nr_runs * sizeof(ext_run_t));
+        free(s->runs);
+        s->runs = runs;
+        s->runs_cap = cap;
+    }
+
+    *w = (ext_writer_t){
+        .run = {.fd = temp_open()},
+        .buf = s->io,
+        .stats = &s->stats,
+        .ok = true,
+    };
+    return w->run.fd >= 0;
+}
+
+/* Finish the run of w and append it to the runs of s */
+static bool writer_close(extsort_t *s, ext_writer_t *w)
+{
+    writer_flush(w);
+    if (!w->ok) {
+        close(w->run.fd);
+        return false;
+    }
+    s->runs[s->nr_runs++] = w->run;
+    return true;
+}
+
+/* Write the chunk out as a sorted run and empty it */
+static bool chunk_spill(extsort_t *s)
+{
+    ext_writer_t w;
+    if (!writer_open(s, &w))
+        return false;
+
+    chunk_sort(s);
+    ext_key_t *keys = chunk_keys(s);
+    for (size_t i = 0; i < s->n && w.ok; i++)
+        writer_record(keys[i].str, strlen(keys[i].str), keys[i].tag, &w);
+    if (!writer_close(s, &w))
+        return false;
+
+    s->stats.runs++;
+    s->used = s->n = 0;
+    return true;
+}
+
+bool extsort_add(extsort_t *s, const char *str, size_t len, void *tag)
+{
+    size_t need = len + 1 + sizeof(ext_key_t);
+    if (chunk_room(s) < need && !chunk_grow(s, need - chunk_room(s)) &&
+        s->n && !chunk_spill(s))
+        return false;
+
+    s->stats.strings++;
+    if (chunk_room(s) < need) {
+        /* Longer than the budget: the string makes a run of its own */
+        ext_writer_t w;
+        if (!writer_open(s, &w))
+            return false;
+        writer_record(str, len, tag, &w);
+        s->stats.runs++;
+        return writer_close(s, &w);
+    }
+
+    char *dst = s->chunk + s->used;
+    memcpy(dst, str, len);
+    dst[len] = '\0';
+    s->used += len + 1;
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < 8; i++)
+        prefix = prefix << 8 | (i < len ? (unsigned char) str[i] : 0);
+    s->n++;
+    *chunk_keys(s) = (ext_key_t){.prefix = prefix, .str = dst, .tag = tag};
+    return true;
+}
+
+/**
+ * ext_reader_t - Buffered reader of a run
+ * @fd: descriptor of the run
+ * @buf: the buffer
+ * @cap: size of @buf
+ * @pos: next byte of @buf to read
+ * @end: bytes in @buf
+ * @rec: the current record, NUL-terminated
+ * @len: length of @rec
+ * @tag: tag of @rec
+ * @rec_cap: size of @rec
+ */
+typedef struct {
+    int fd;
+    char *buf;
+    size_t cap;
+    size_t pos;
+    size_t end;
+    char *rec;
+    size_t len;
+    void *tag;
+    size_t rec_cap;
+} ext_reader_t;
+
+/* Refill the buffer, returning 1 on success, 0 at the end and -1 on error */
+static int reader_fill(ext_reader_t *r)
+{
+    ssize_t n;
+    do
+        n = read(r->fd, r->buf, r->cap);
+    while (n < 0 && errno == EINTR);
+    if (n <= 0)
+        return n;
+
+    r->pos = 0;
+    r->end = n;
+    return 1;
+}
+
+/* Read a varint, returning 1 on success, 0 at the end before its first byte
+ * and -1 on error or if it is cut short
+ */
+static int reader_varint(ext_reader_t *r, uint64_t *v)
+{
+    int shift = 0, c;
+    *v = 0;
+    do {
+        if (r->pos == r->end) {
+            int ret = reader_fill(r);
+            if (ret <= 0)
+                return ret < 0 || shift ? -1 : 0;
+        }
+        c = (unsigned char) r->buf[r->pos++];
+        *v |= (uint64_t) (c & 0x7f) << shift;
+        shift += 7;
+    } while (c & 0x80);
+    return 1;
+}
+
+/* Load the next record, returning 1 on success, 0 at the end and -1 on
+ * error or for a truncated record.
+ */
+static int reader_next(ext_reader_t *r)
+{
+    uint64_t len, tag;
+    int ret = reader_varint(r, &len);
+    if (ret <= 0)
+        return ret;
+
+    if (len + 1 > r->rec_cap) {
+        size_t cap = r->rec_cap ? r->rec_cap : 64;
+        while (cap < len + 1)
+            cap *= 2;
+        char *rec = malloc(cap);
+        if (!rec)
+            return -1;
+        free(r->rec);
+        r->rec = rec;
+        r->rec_cap = cap;
+    }
+
+    for (size_t off = 0; off < len;) {
+        if (r->pos == r->end && reader_fill(r) <= 0)
+            return -1;
+        size_t n = r->end - r->pos < len - off ? r->end - r->pos : len - off;
+        memcpy(r->rec + off, r->buf + r->pos, n);
+        r->pos += n;
+        off += n;
+    }
+    r->rec[len] = '\0';
+    r->len = len;
+
+    if (reader_varint(r, &tag) <= 0)
+        return -1;
+    r->tag = (void *) (uintptr_t) tag;
+    return 1;
+}
+
+/* Whether the current record of a goes before that of b */
+static inline bool reader_before(const extsort_t *s,
+                                 const ext_reader_t *a,
+                                 const ext_reader_t *b)
+{
+    int cmp = strcmp(a->rec, b->rec);
+    return s->descend ? cmp > 0 : cmp < 0;
+}
+
+/* Sift the reader at i down the heap of n readers */
+static void heap_down(const extsort_t *s,
+                      ext_reader_t **heap,
+                      size_t n,
+                      size_t i)
+{
+    for (;;) {
+        size_t min = i, l = 2 * i + 1, r = l + 1;
+        if (l < n && reader_before(s, heap[l], heap[min]))
+            min = l;
+        if (r < n && reader_before(s, heap[r], heap[min]))
+            min = r;
+        if (min == i)
+            return;
+
+        ext_reader_t *tmp = heap[i];
+        heap[i] = heap[min];
+        heap[min] = tmp;
+        i = min;
+    }
+}
+
+/* Merge the k runs starting at runs into emit, closing them */
+static bool merge_runs(extsort_t *s,
+                       ext_run_t *runs,
+                       size_t k,
+                       extsort_emit_t emit,
+                       void *arg)
+{
+    size_t cap = s->budget / (k + 1);
+    if (cap < IO_MIN)
+        cap = IO_MIN;
+
+    ext_reader_t *readers = malloc(k * sizeof(ext_reader_t));
+    ext_reader_t **heap = malloc(k * sizeof(ext_reader_t *));
+    bool ok = readers && heap;
+    for (size_t i = 0; readers && i < k; i++)
+        readers[i] = (ext_reader_t){.fd = runs[i].fd, .cap = cap};
+
+    size_t n = 0;
+    for (size_t i = 0; ok && i < k; i++) {
+        ext_reader_t *r = &readers[i];
+        ok = (r->buf = malloc(cap)) && lseek(r->fd, 0, SEEK_SET) == 0;
+
+        int ret = ok ? reader_next(r) : 0;
+        ok = ok && ret >= 0;
+        if (ret > 0)
+            heap[n++] = r;
+    }
+    for (size_t i = n / 2; ok && i-- > 0;)
+        heap_down(s, heap, n, i);
+
+    while (ok && n) {
+        ext_reader_t *top = heap[0];
+        ok = emit(top->rec, top->len, top->tag, arg);
+
+        int ret = ok ? reader_next(top) : 0;
+        ok = ok && ret >= 0;
+        if (!ret)
+            heap[0] = heap[--n];
+        heap_down(s, heap, n, 0);
+    }
+
+    for (size_t i = 0; i < k; i++) {
+        if (readers) {
+            free(readers[i].buf);
+            free(readers[i].rec);
+        }
+        close(runs[i].fd);
+    }
+    free(heap);
+    free(readers);
+    return ok;
+}
+
+/* Merge the first EXTSORT_FANIN runs into one at the end of the runs */
+static bool merge_pass(extsort_t *s)
+{
+    ext_writer_t w;
+    if (!writer_open(s, &w))
+        return false;
+
+    bool ok = merge_runs(s, s->runs, EXTSORT_FANIN, writer_record, &w);
+    s->nr_runs -= EXTSORT_FANIN;
+    memmove(s->runs, s->runs + EXTSORT_FANIN, s->nr_runs * sizeof(ext_run_t));
+    if (!ok) {
+        close(w.run.fd);
+        return false;
+    }
+
+    s->stats.passes++;
+    return writer_close(s, &w);
+}
+
+bool extsort_finish(extsort_t *s, extsort_emit_t emit, void *arg)
+{
+    if (!s->nr_runs) {
+        /* Everything fitted in memory */
+        chunk_sort(s);
+        ext_key_t *keys = chunk_keys(s);
+        for (size_t i = 0; i < s->n; i++) {
+            if (!emit(keys[i].str, strlen(keys[i].str), keys[i].tag, arg))
+                return false;
+        }
+        return true;
+    }
+
+    if (s->n && !chunk_spill(s))
+        return false;
+
+    /* The merge buffers take over the memory of the chunk */
+    free(s->chunk);
+    s->chunk = NULL;
+    s->cap = 0;
+
+    while (s->nr_runs > EXTSORT_FANIN) {
+        if (!merge_pass(s))
+            return false;
+    }
+
+    size_t k = s->nr_runs;
+    s->nr_runs = 0;
+    return merge_runs(s, s->runs, k, emit, arg);
+}
+
+/**
+ * ext_order_t - Elements of a queue in the order they come out of the sort
+ * @elems: the elements
+ * @n: elements so far
+ * @cap: size of @elems
+ */
+typedef struct {
+    element_t **elems;
+    size_t n;
+    size_t cap;
+} ext_order_t;
+
+static bool emit_order(const char *str, size_t len, void *tag, void *arg)
+{
+    (void) str, (void) len;
+    ext_order_t *o = arg;
+    if (o->n == o->cap)
+        return false;
+    o->elems[o->n++] = tag;
+    return true;
+}
+
+bool extsort_queue(struct list_head *head,
+                   bool descend,
+                   size_t budget,
+                   extsort_stats_t *stats)
+{
+    if (!head)
+        return false;
+
+    /* Walking the nodes as they are linked gets the same elements either way
+     * round, so a pending reversal only flips the order to sort them in
+     */
+    descend = descend != q_reversed(head);
+    ext_order_t order = {.cap = q_size(head)};
+    order.elems = malloc((order.cap ? order.cap : 1) * sizeof(element_t *));
+    extsort_t *s = extsort_new(budget, descend);
+    bool ok = order.elems && s;
+
+    for (struct list_head *node = head->next; ok && node != head;
+         node = node->next) {
+        element_t *e = list_entry(node, element_t, list);
+        ok = extsort_add(s, e->value, strlen(e->value), e);
+    }
+    ok = ok && extsort_finish(s, emit_order, &order) && order.n == order.cap;
+
+    if (ok) {
+        INIT_LIST_HEAD(head);
+        for (size_t i = 0; i < order.n; i++)
+            list_add_tail(&order.elems[i]->list, head);
+        q_reordered(head);
+    }
+
+    if (stats && s)
+        *stats = s->stats;
+    extsort_free(s);
+    free(order.elems);
+    return ok;
+}
@@ -0,0 +1,109 @@
+#ifndef LAB0_EXTSORT_H
+#define LAB0_EXTSORT_H
+
+/* External merge sort of strings under a memory budget.
+ *
+ * Strings are gathered in a chunk of at most the budget in bytes, with the
+ * characters packed from its start and, from its end, a pointer to each
+ * along with its first 8 bytes as an integer. When the two meet, the
+ * pointers are put in order by an in-place MSD radix sort, which mostly gets
+ * by on those integers, and the strings are written out as a sorted run: a
+ * temporary file of records, each a LEB128 varint length followed by as
+ * many bytes and by the tag of the string as another varint. Once every
+ * string is in, the runs are read back through buffers that share the budget
+ * and combined by a k-way merge over a binary heap. Should there be more
+ * than EXTSORT_FANIN runs, the first ones are merged into longer runs
+ * beforehand, so the open files and the read buffers stay bounded. If all
+ * the strings fit in the chunk, nothing touches the disk at all.
+ *
+ * Temporary files are created in $TMPDIR, /tmp if that is unset, and are
+ * unlinked right away, so they vanish with the sort even if it is abandoned.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "list.h"
+
+/* Default memory budget in bytes */
+#define EXTSORT_BUDGET (64 << 20)
+
+/* Smallest memory budget in bytes */
+#define EXTSORT_BUDGET_MIN 4096
+
+/* Most runs merged at once */
+#define EXTSORT_FANIN 64
+
+typedef struct extsort extsort_t;
+
+/**
+ * extsort_stats_t - What a sort had to do
+ * @strings: strings added
+ * @runs: sorted runs written, zero if the strings fitted in memory
+ * @passes: merges of EXTSORT_FANIN runs into a longer run before the last
+ * @spilled: bytes written to temporary files, by runs and passes
+ */
+typedef struct {
+    uint64_t strings;
+    uint64_t runs;
+    uint64_t passes;
+    uint64_t spilled;
+} extsort_stats_t;
+
+/* Callback receiving the sorted strings one at a time, each with the tag it
+ * was added with. The string is only valid during the call. Return false to
+ * stop the sort.
+ */
+typedef bool (*extsort_emit_t)(const char *s,
+                               size_t len,
+                               void *tag,
+                               void *arg);
+
+/* Create an empty sort holding at most budget bytes of strings in memory,
+ * raised to EXTSORT_BUDGET_MIN if lower.
+ * Return NULL for allocation failed.
+ */
+extsort_t *extsort_new(size_t budget, bool descend);
+
+/* Free the sort along with its temporary files, no effect if s is NULL */
+void extsort_free(extsort_t *s);
+
+/* Add the string s of len bytes along with an opaque tag handed back with it,
+ * spilling a run if the chunk is full.
+ * Return false if a run could not be written.
+ */
+bool extsort_add(extsort_t *s, const char *str, size_t len, void *tag);
+
+/* Merge everything added so far and pass it to emit in sorted order. No
+ * string may be added afterwards.
+ * Return false if a temporary file could not be read or written, or if emit
+ * returned false.
+ */
+bool extsort_finish(extsort_t *s, extsort_emit_t emit, void *arg);
+
+/* Statistics of the sort so far */
+const extsort_stats_t *extsort_stats(const extsort_t *s);
+
+/**
+ * extsort_queue() - Sort a queue through the external merge sort
+ * @head: header of the queue
+ * @descend: whether or not to sort in descending order
+ * @budget: memory budget in bytes for the strings held outside the queue
+ * @stats: filled in with the statistics of the sort, unless NULL
+ *
+ * The strings are sorted along with a pointer to their element, and once
+ * merged the elements are relinked in the order their pointers come back, so
+ * none is copied or reallocated. Beyond the budget, the sort only takes a
+ * pointer per element.
+ *
+ * Return: true if the queue is sorted, false if a temporary file could not be
+ * read or written or memory could not be allocated, in which case the queue
+ * is left as it was.
+ */
+bool extsort_queue(struct list_head *head,
+                   bool descend,
+                   size_t budget,
+                   extsort_stats_t *stats);
+
+#endif /* LAB0_EXTSORT_H */
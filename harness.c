@@ -42,6 +42,41 @@ typedef struct __block_element {
 
 static block_element_t *allocated = NULL;
 static size_t allocated_count = 0;
+static size_t allocated_bytes = 0;
+
+/* With the pool turned on by set_pool_mode(), small blocks are pooled: a
+ * freed block goes onto the free list of its size class, and the next
+ * allocation of that class takes it back without calling into libc. Fresh
+ * blocks are carved out of slabs of POOL_SLAB_BLOCKS blocks. Pooled blocks
+ * keep their magic header and footer, and are counted by allocation_check()
+ * only while handed out.
+ *
+ * A pooled block is never handed back to libc, which hides use after free,
+ * double free and overflows of small blocks from AddressSanitizer and
+ * valgrind, so the pool is off by default and cannot be turned on under
+ * either of them.
+ */
+#define POOL_GRANULE 16
+#define POOL_CLASSES 16
+#define POOL_SLAB_BLOCKS 64
+
+/* Slabs stay linked together so they remain reachable until exit */
+typedef struct __slab {
+    struct __slab *next;
+    unsigned char blocks[] __attribute__((aligned(POOL_GRANULE)));
+} slab_t;
+
+static bool pool_mode = false;
+static slab_t *slabs = NULL;
+static block_element_t *pool_free_list[POOL_CLASSES];
+
+#if defined(__SANITIZE_ADDRESS__)
+#define POOL_SANITIZED 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define POOL_SANITIZED 1
+#endif
+#endif
 
 /* Percent probability of malloc failure */
 int fail_probability = 0;
@@ -115,6 +150,59 @@ static size_t *find_footer(block_element_t *b)
     return p;
 }
 
+/* Size class serving a payload of given size, -1 if it is not pooled */
+static int pool_class(size_t size)
+{
+    if (!pool_mode || size > POOL_GRANULE * POOL_CLASSES)
+        return -1;
+    return size ? (size - 1) / POOL_GRANULE : 0;
+}
+
+/* Space taken by a block of the given class, including header and footer */
+static size_t pool_block_size(int class)
+{
+    size_t size = sizeof(block_element_t) + (class + 1) * POOL_GRANULE +
+                  sizeof(size_t);
+    return (size + POOL_GRANULE - 1) & ~(size_t) (POOL_GRANULE - 1);
+}
+
+/* Take a block of the given class, refilling its free list when empty */
+static block_element_t *pool_alloc(int class)
+{
+    if (!pool_free_list[class]) {
+        size_t bsize = pool_block_size(class);
+        slab_t *slab = malloc(sizeof(slab_t) + bsize * POOL_SLAB_BLOCKS);
+        if (!slab)
+            return NULL;
+        slab->next = slabs;
+        slabs = slab;
+
+        for (int i = POOL_SLAB_BLOCKS - 1; i >= 0; i--) {
+            block_element_t *b =
+                (block_element_t *) (slab->blocks + (size_t) i * bsize);
+            b->next = pool_free_list[class];
+            pool_free_list[class] = b;
+        }
+    }
+
+    block_element_t *b = pool_free_list[class];
+    pool_free_list[class] = b->next;
+    return b;
+}
+
+/* Hand a block back to libc, or to its free list if it is pooled */
+static void pool_release(block_element_t *b)
+{
+    int class = pool_class(b->payload_size);
+    if (class < 0) {
+        free(b);
+        return;
+    }
+
+    b->next = pool_free_list[class];
+    pool_free_list[class] = b;
+}
+
 /* Implementation of application functions */
 
 void *test_malloc(size_t size)
@@ -129,8 +217,10 @@ void *test_malloc(size_t size)
         return NULL;
     }
 
+    int class = pool_class(size);
     block_element_t *new_block =
-        malloc(size + sizeof(block_element_t) + sizeof(size_t));
+        class < 0 ? malloc(size + sizeof(block_element_t) + sizeof(size_t))
+                  : pool_alloc(class);
     if (!new_block) {
         report_event(MSG_FATAL, "Couldn't allocate any more memory");
         error_occurred = true;
@@ -152,6 +242,7 @@ void *test_malloc(size_t size)
         allocated->prev = new_block;
     allocated = new_block;
     allocated_count++;
+    allocated_bytes += size;
 
     return p;
 }
@@ -201,8 +292,9 @@ void test_free(void *p)
     if (bn)
         bn->prev = bp;
 
-    free(b);
     allocated_count--;
+    allocated_bytes -= b->payload_size;
+    pool_release(b);
 }
 
 // cppcheck-suppress unusedFunction
@@ -221,6 +313,11 @@ size_t allocation_check()
     return allocated_count;
 }
 
+size_t allocation_bytes()
+{
+    return allocated_bytes;
+}
+
 /* Implementation of functions for testing */
 
 /* Set/unset cautious mode.
@@ -231,6 +328,39 @@ void set_cautious_mode(bool cautious)
     cautious_mode = cautious;
 }
 
+/* Whether the program runs under valgrind, which preloads its own library */
+static bool under_valgrind(void)
+{
+    const char *preload = getenv("LD_PRELOAD");
+    return preload && strstr(preload, "vgpreload");
+}
+
+bool set_pool_mode(bool pool)
+{
+    if (pool == pool_mode)
+        return true;
+    /* Every block has to go back where it came from */
+    if (allocated_count)
+        return false;
+
+    if (pool) {
+#ifdef POOL_SANITIZED
+        return false;
+#endif
+        if (under_valgrind())
+            return false;
+    } else {
+        while (slabs) {
+            slab_t *next = slabs->next;
+            free(slabs);
+            slabs = next;
+        }
+        memset(pool_free_list, 0, sizeof(pool_free_list));
+    }
+    pool_mode = pool;
+    return true;
+}
+
 /* Set/unset restricted allocation mode.
  * In this mode, calls to malloc and free are disallowed.
  */
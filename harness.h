@@ -21,6 +21,9 @@ char *test_strdup(const char *s);
 /* Report number of allocated blocks */
 size_t allocation_check();
 
+/* Report number of payload bytes held by allocated blocks */
+size_t allocation_bytes();
+
 /* Probability of malloc failing, expressed as percent */
 extern int fail_probability;
 
@@ -30,6 +33,13 @@ extern int fail_probability;
  */
 void set_cautious_mode(bool cautious);
 
+/*
+ * Turn the pool of small blocks on or off. Return false if blocks are still
+ * allocated, or if the pool is asked for under AddressSanitizer or valgrind,
+ * which could no longer see errors on pooled blocks.
+ */
+bool set_pool_mode(bool pool);
+
 /*
  * Set/unset restricted allocation mode.
  * In this mode, calls to malloc and free are disallowed.
@@ -0,0 +1,120 @@
+/* String interning arena backed by hlist buckets */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hlist.h"
+#include "intern.h"
+
+/* The bucket array uses regular malloc/free, the strings go through the
+ * harness so that they are subject to leak checking like any queue element.
+ */
+#define INTERNAL 1
+#include "harness.h"
+
+#define INTERN_MIN_BUCKETS 1024
+
+typedef struct {
+    struct hlist_node node;
+    uint32_t hash;
+    int refcnt;
+    char str[];
+} intern_entry_t;
+
+int intern_mode = 0;
+
+static struct hlist_head *buckets = NULL;
+static size_t nr_buckets = 0;
+static size_t nr_entries = 0;
+
+/* 32-bit FNV-1a */
+uint32_t intern_hash(const char *s)
+{
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (unsigned char) *s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Move every entry into a bucket array of the given size */
+static bool intern_rehash(size_t size)
+{
+    struct hlist_head *table = malloc(sizeof(struct hlist_head) * size);
+    if (!table)
+        return false;
+    for (size_t i = 0; i < size; i++)
+        INIT_HLIST_HEAD(&table[i]);
+
+    for (size_t i = 0; i < nr_buckets; i++) {
+        while (!hlist_empty(&buckets[i])) {
+            intern_entry_t *e =
+                hlist_entry(buckets[i].first, intern_entry_t, node);
+            hlist_del(&e->node);
+            hlist_add_head(&e->node, &table[e->hash & (size - 1)]);
+        }
+    }
+
+    free(buckets);
+    buckets = table;
+    nr_buckets = size;
+    return true;
+}
+
+char *intern_get(const char *s)
+{
+    uint32_t hash = intern_hash(s);
+
+    if (nr_buckets) {
+        intern_entry_t *e = NULL;
+        hlist_for_each_entry (e, &buckets[hash & (nr_buckets - 1)], node) {
+            if (e->hash == hash && !strcmp(e->str, s)) {
+                e->refcnt++;
+                return e->str;
+            }
+        }
+    }
+
+    /* Keep the load factor at most one; a failed resize is not fatal */
+    if (nr_entries >= nr_buckets)
+        intern_rehash(nr_buckets ? nr_buckets << 1 : INTERN_MIN_BUCKETS);
+    if (!nr_buckets)
+        return NULL;
+
+    size_t len = strlen(s) + 1;
+    intern_entry_t *e = test_malloc(sizeof(intern_entry_t) + len);
+    if (!e)
+        return NULL;
+
+    e->hash = hash;
+    e->refcnt = 1;
+    memcpy(e->str, s, len);
+    hlist_add_head(&e->node, &buckets[hash & (nr_buckets - 1)]);
+    nr_entries++;
+    return e->str;
+}
+
+void intern_put(char *s)
+{
+    intern_entry_t *e =
+        (intern_entry_t *) (s - offsetof(intern_entry_t, str));
+    if (--e->refcnt)
+        return;
+
+    hlist_del(&e->node);
+    test_free(e);
+
+    /* Give the bucket array back once the arena runs empty */
+    if (!--nr_entries) {
+        free(buckets);
+        buckets = NULL;
+        nr_buckets = 0;
+    }
+}
+
+size_t intern_count()
+{
+    return nr_entries;
+}
@@ -0,0 +1,37 @@
+#ifndef LAB0_INTERN_H
+#define LAB0_INTERN_H
+
+/* String interning arena shared by all queues.
+ *
+ * Each distinct string is stored once, together with a reference count.
+ * When interning mode is on, queue elements point at the shared copy instead
+ * of carrying their own, so inserting a value which is already present only
+ * costs a reference count bump, and two elements holding the same value can
+ * be recognized by comparing pointers.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Whether newly inserted queue elements intern their strings */
+extern int intern_mode;
+
+/* Return the shared copy of s, taking a reference on it.
+ * Return NULL if a new copy was needed but could not be allocated.
+ */
+char *intern_get(const char *s);
+
+/* Drop a reference obtained from intern_get(), freeing the copy with the
+ * last one.
+ */
+void intern_put(char *s);
+
+/* The 32-bit FNV-1a hash of s used by the arena, shared with other string
+ * hash tables
+ */
+uint32_t intern_hash(const char *s);
+
+/* Number of distinct strings currently held by the arena */
+size_t intern_count();
+
+#endif /* LAB0_INTERN_H */
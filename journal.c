@@ -0,0 +1,393 @@
+/* Append-only write-ahead journal of the operations on a queue */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "journal.h"
+#include "queue.h"
+
+/* Bytes of the file header: the magic and the version */
+#define HEADER_SIZE 12
+
+/* Bytes of a record before its string: CRC-32, string length including the
+ * terminator, operation and argument
+ */
+#define RECORD_SIZE 13
+
+/* Initial capacity of the buffer of a group */
+#define GROUP_MIN 4096
+
+/**
+ * struct journal - An open journal
+ * @fd: the file, opened for appending
+ * @size: bytes of the file up to the end of the last group committed
+ * @buf: records of the pending group
+ * @len: bytes in @buf
+ * @cap: size of @buf
+ * @pending: records in @buf
+ * @first_ns: when the oldest record in @buf was logged
+ * @batch: records per group, 0 for no limit
+ * @delay_us: microseconds the oldest record may wait, 0 for no limit
+ * @stats: what the journal did since it was opened
+ */
+struct journal {
+    int fd;
+    off_t size;
+    char *buf;
+    size_t len;
+    size_t cap;
+    int pending;
+    uint64_t first_ns;
+    int batch;
+    long delay_us;
+    journal_stats_t stats;
+};
+
+static uint32_t crc_table[256];
+
+/* CRC-32 as used by zlib and Ethernet, polynomial 0xedb88320 reflected */
+static uint32_t crc32(const void *p, size_t n)
+{
+    if (!crc_table[1]) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            crc_table[i] = c;
+        }
+    }
+
+    uint32_t crc = ~0u;
+    for (const unsigned char *b = p; n--; b++)
+        crc = crc_table[(crc ^ *b) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static inline uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Write all of p to fd, false with errno set on failure */
+static bool write_all(int fd, const char *p, size_t n)
+{
+    while (n) {
+        ssize_t done = write(fd, p, n);
+        if (done < 0 && errno != EINTR)
+            return false;
+        if (done > 0) {
+            p += done;
+            n -= done;
+        }
+    }
+    return true;
+}
+
+/* Apply the operation of a record to the queue */
+static bool apply(struct list_head *head, int op, int arg, const char *s)
+{
+    element_t *e = NULL;
+    LIST_HEAD(removed);
+
+    switch (op) {
+    case JOURNAL_INSERT_HEAD:
+        /* q_insert_head() and q_insert_tail() only copy the string */
+        return s && q_insert_head(head, (char *) s);
+    case JOURNAL_INSERT_TAIL:
+        return s && q_insert_tail(head, (char *) s);
+    case JOURNAL_REMOVE_HEAD:
+    case JOURNAL_REMOVE_TAIL:
+        e = op == JOURNAL_REMOVE_HEAD ? q_remove_head(head, NULL, 0)
+                                      : q_remove_tail(head, NULL, 0);
+        if (e)
+            q_release_element(e);
+        return e;
+    case JOURNAL_REMOVE_HEAD_N:
+    case JOURNAL_CLEAR:
+        if (op == JOURNAL_CLEAR)
+            arg = q_size(head);
+        if (arg && q_remove_head_n(head, arg, &removed) != arg)
+            return false;
+        element_t *safe = NULL;
+        list_for_each_entry_safe (e, safe, &removed, list)
+            q_release_element(e);
+        return true;
+    case JOURNAL_REVERSE:
+        q_reverse(head);
+        return true;
+    case JOURNAL_REVERSE_K:
+        q_reverseK(head, arg);
+        return true;
+    case JOURNAL_SWAP:
+        q_swap(head);
+        return true;
+    case JOURNAL_SORT:
+        q_sort(head, arg);
+        return true;
+    case JOURNAL_DEDUP:
+        return q_delete_dup(head);
+    case JOURNAL_DEDUP_UNSORTED:
+        return q_delete_dup_unsorted(head, arg);
+    case JOURNAL_DELETE_MID:
+        return q_delete_mid(head);
+    case JOURNAL_DELETE_AT:
+        return q_delete_at(head, arg);
+    case JOURNAL_ASCEND:
+        q_ascend(head);
+        return true;
+    case JOURNAL_DESCEND:
+        q_descend(head);
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* Replay the records of a mapped journal of len bytes, returning the length
+ * of the part made of good records, or 0 with errno set if an operation
+ * could not be replayed.
+ */
+static size_t replay(journal_t *j,
+                     const char *map,
+                     size_t len,
+                     struct list_head *head)
+{
+    size_t pos = HEADER_SIZE;
+    while (len - pos >= RECORD_SIZE) {
+        const char *rec = map + pos;
+        uint32_t crc, slen;
+        int32_t arg;
+        memcpy(&crc, rec, 4);
+        memcpy(&slen, rec + 4, 4);
+        memcpy(&arg, rec + 9, 4);
+        if (slen > len - pos - RECORD_SIZE ||
+            crc != crc32(rec + 4, RECORD_SIZE - 4 + slen))
+            break;
+
+        const char *s = slen ? rec + RECORD_SIZE : NULL;
+        if (s && strnlen(s, slen) != slen - 1)
+            break;
+        if (!apply(head, (unsigned char) rec[8], arg, s)) {
+            errno = ENOMEM;
+            return 0;
+        }
+        j->stats.replayed++;
+        pos += RECORD_SIZE + slen;
+    }
+    return pos;
+}
+
+journal_t *journal_open(const char *path,
+                        struct list_head *head,
+                        int batch,
+                        long delay_us)
+{
+    if (!path || !head) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    journal_t *j = malloc(sizeof(journal_t));
+    if (!j) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    *j = (journal_t){.batch = batch, .delay_us = delay_us};
+
+    j->fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    struct stat st;
+    if (j->fd < 0 || fstat(j->fd, &st))
+        goto fail;
+
+    if (!st.st_size) {
+        char header[HEADER_SIZE] = JOURNAL_MAGIC;
+        uint32_t version = JOURNAL_VERSION;
+        memcpy(header + 8, &version, 4);
+        if (!write_all(j->fd, header, HEADER_SIZE) || fdatasync(j->fd))
+            goto fail;
+        j->size = HEADER_SIZE;
+        return j;
+    }
+
+    char *map = MAP_FAILED;
+    if (st.st_size >= HEADER_SIZE)
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, j->fd, 0);
+    if (map == MAP_FAILED) {
+        errno = st.st_size < HEADER_SIZE ? EINVAL : errno;
+        goto fail;
+    }
+
+    uint32_t version;
+    memcpy(&version, map + 8, 4);
+    size_t good = 0;
+    if (memcmp(map, JOURNAL_MAGIC, 8) || version != JOURNAL_VERSION)
+        errno = EINVAL;
+    else
+        good = replay(j, map, st.st_size, head);
+    munmap(map, st.st_size);
+    if (!good)
+        goto fail;
+
+    /* Cut off a torn or corrupt tail, so new records follow good ones */
+    if (good < (size_t) st.st_size) {
+        j->stats.dropped = st.st_size - good;
+        if (ftruncate(j->fd, good) || fdatasync(j->fd))
+            goto fail;
+    }
+    j->size = good;
+    return j;
+
+fail:;
+    int err = errno;
+    if (j->fd >= 0)
+        close(j->fd);
+    free(j);
+    errno = err;
+    return NULL;
+}
+
+bool journal_commit(journal_t *j)
+{
+    if (!j->pending)
+        return true;
+
+    /* Part of the group may have reached the file, and committing it again
+     * must not follow that part
+     */
+    if (!write_all(j->fd, j->buf, j->len) || fdatasync(j->fd)) {
+        int err = errno;
+        if (!ftruncate(j->fd, j->size))
+            fdatasync(j->fd);
+        errno = err;
+        return false;
+    }
+    j->size += j->len;
+    j->stats.bytes += j->len;
+    j->stats.commits++;
+    j->len = 0;
+    j->pending = 0;
+    return true;
+}
+
+/* Commit the pending group if it is full or has waited long enough */
+static bool commit_if_due(journal_t *j)
+{
+    if (!j->pending)
+        return true;
+    if ((j->batch > 0 && j->pending >= j->batch) ||
+        (j->delay_us > 0 &&
+         now_ns() - j->first_ns >= (uint64_t) j->delay_us * 1000))
+        return journal_commit(j);
+    return true;
+}
+
+bool journal_poll(journal_t *j, long *due_us)
+{
+    bool ok = commit_if_due(j);
+    *due_us = -1;
+    if (j->pending && j->delay_us > 0) {
+        uint64_t waited_us = (now_ns() - j->first_ns) / 1000;
+        *due_us = waited_us < (uint64_t) j->delay_us
+                      ? j->delay_us - (long) waited_us
+                      : 0;
+    }
+    return ok;
+}
+
+bool journal_close(journal_t *j)
+{
+    if (!j)
+        return true;
+
+    bool ok = journal_commit(j);
+    int err = errno;
+    close(j->fd);
+    free(j->buf);
+    free(j);
+    errno = err;
+    return ok;
+}
+
+bool journal_crash(journal_t *j, size_t torn)
+{
+    bool ok = write_all(j->fd, j->buf, torn < j->len ? torn : j->len);
+    int err = errno;
+    close(j->fd);
+    free(j->buf);
+    free(j);
+    errno = err;
+    return ok;
+}
+
+bool journal_set_commit(journal_t *j, int batch, long delay_us)
+{
+    j->batch = batch;
+    j->delay_us = delay_us;
+    return commit_if_due(j);
+}
+
+bool journal_log(journal_t *j, journal_op_t op, int arg, const char *s)
+{
+    uint32_t slen = s ? strlen(s) + 1 : 0;
+    size_t need = RECORD_SIZE + slen;
+    if (j->len + need > j->cap) {
+        size_t cap = j->cap ? 2 * j->cap : GROUP_MIN;
+        while (cap < j->len + need)
+            cap *= 2;
+        char *buf = malloc(cap);
+        if (!buf) {
+            errno = ENOMEM;
+            return false;
+        }
+        if (j->len)
+            memcpy(buf, j->buf, j->len);
+        free(j->buf);
+        j->buf = buf;
+        j->cap = cap;
+    }
+
+    char *rec = j->buf + j->len;
+    int32_t a = arg;
+    memcpy(rec + 4, &slen, 4);
+    rec[8] = op;
+    memcpy(rec + 9, &a, 4);
+    if (slen)
+        memcpy(rec + RECORD_SIZE, s, slen);
+    uint32_t crc = crc32(rec + 4, need - 4);
+    memcpy(rec, &crc, 4);
+
+    if (!j->pending)
+        j->first_ns = now_ns();
+    j->len += need;
+    j->pending++;
+    j->stats.records++;
+    return commit_if_due(j);
+}
+
+bool journal_log_contents(journal_t *j, struct list_head *head)
+{
+    if (!journal_log(j, JOURNAL_CLEAR, 0, NULL))
+        return false;
+
+    bool rev = q_reversed(head);
+    for (struct list_head *node = rev ? head->prev : head->next; node != head;
+         node = rev ? node->prev : node->next) {
+        const char *value = list_entry(node, element_t, list)->value;
+        if (!journal_log(j, JOURNAL_INSERT_TAIL, 0, value))
+            return false;
+    }
+    return true;
+}
+
+const journal_stats_t *journal_stats(const journal_t *j)
+{
+    return &j->stats;
+}
@@ -0,0 +1,134 @@
+#ifndef LAB0_JOURNAL_H
+#define LAB0_JOURNAL_H
+
+/* Append-only write-ahead journal of the operations on a queue.
+ *
+ * Every mutation of a journaled queue is appended to the journal as a record
+ * carrying the operation, an integer argument and, for insertions, the
+ * string inserted, so replaying the records on an empty queue rebuilds it.
+ * Operations whose outcome cannot be derived again, such as a shuffle, are
+ * logged as the whole resulting queue instead.
+ *
+ * Records are gathered in memory and committed as a group: written with one
+ * write() and flushed with one fdatasync() once the group holds a given
+ * number of records, or once its oldest record has waited a given number of
+ * microseconds, checked when another record arrives and by journal_poll()
+ * while the caller is idle. A commit which fails is cut off the file again,
+ * so the group can be committed anew. The records of a group which
+ * has not been committed yet are lost in a crash, which is the price of
+ * fewer flushes; a group size of 1 commits every operation before it is
+ * acknowledged.
+ *
+ * Each record starts with a CRC-32 of the rest of it. When a journal is
+ * opened, its records are replayed up to the first one which is torn or
+ * corrupt, and the file is cut back to the end of the last good one.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "list.h"
+
+#define JOURNAL_MAGIC "lab0-j\n"
+#define JOURNAL_VERSION 1
+
+/* Operations of the records */
+typedef enum {
+    JOURNAL_INSERT_HEAD = 1,
+    JOURNAL_INSERT_TAIL,
+    JOURNAL_REMOVE_HEAD,
+    JOURNAL_REMOVE_TAIL,
+    JOURNAL_REMOVE_HEAD_N, /* argument: number of elements */
+    JOURNAL_REVERSE,
+    JOURNAL_REVERSE_K, /* argument: k */
+    JOURNAL_SWAP,
+    JOURNAL_SORT, /* argument: whether in descending order */
+    JOURNAL_DEDUP,
+    JOURNAL_DEDUP_UNSORTED, /* argument: whether the first copy is kept */
+    JOURNAL_DELETE_MID,
+    JOURNAL_DELETE_AT, /* argument: position */
+    JOURNAL_ASCEND,
+    JOURNAL_DESCEND,
+    JOURNAL_CLEAR,
+} journal_op_t;
+
+typedef struct journal journal_t;
+
+/**
+ * journal_stats_t - What a journal did since it was opened
+ * @replayed: records replayed when it was opened
+ * @dropped: bytes of a torn or corrupt tail cut off when it was opened
+ * @records: records logged
+ * @commits: groups committed, each with one fdatasync()
+ * @bytes: bytes written
+ */
+typedef struct {
+    uint64_t replayed;
+    uint64_t dropped;
+    uint64_t records;
+    uint64_t commits;
+    uint64_t bytes;
+} journal_stats_t;
+
+/**
+ * journal_open() - Open a journal, replaying it onto a queue
+ * @path: the journal file, created if missing
+ * @head: header of the queue, which should be empty
+ * @batch: records per group, 0 for no limit
+ * @delay_us: microseconds the oldest record of a group may wait, 0 for no
+ *            limit
+ *
+ * Return: the journal, NULL with errno set if the file could not be opened
+ * or read, is not a journal, or an operation could not be replayed
+ */
+journal_t *journal_open(const char *path,
+                        struct list_head *head,
+                        int batch,
+                        long delay_us);
+
+/* Commit the pending group and close the journal, no effect if j is NULL.
+ * Return false with errno set if the commit failed.
+ */
+bool journal_close(journal_t *j);
+
+/* Change when groups are committed, committing the pending one if it is
+ * already due.
+ * Return false with errno set if that commit failed.
+ */
+bool journal_set_commit(journal_t *j, int batch, long delay_us);
+
+/* Log an operation, with the string inserted by an insertion and NULL
+ * otherwise, committing the group if it is due.
+ * Return false with errno set for allocation failed or if the commit failed.
+ */
+bool journal_log(journal_t *j, journal_op_t op, int arg, const char *s);
+
+/* Log the whole queue in place of what was there before: a clear followed
+ * by an insertion at the tail of every element, from head to tail.
+ * Return false with errno set for allocation failed or if a commit failed.
+ */
+bool journal_log_contents(journal_t *j, struct list_head *head);
+
+/* Close the journal the way a crash in the middle of a commit would leave
+ * it, for testing recovery: only the first torn bytes of the pending group
+ * reach the file, and the rest is lost.
+ * Return false with errno set if those bytes could not be written.
+ */
+bool journal_crash(journal_t *j, size_t torn);
+
+/* Write and flush the pending group, if any.
+ * Return false with errno set if that failed, with the group still pending.
+ */
+bool journal_commit(journal_t *j);
+
+/* Commit the pending group if it has waited long enough, for callers idling
+ * between operations, and store in *due_us the microseconds until the group
+ * then pending is due, or -1 if none waits on a delay.
+ * Return false with errno set if the commit failed.
+ */
+bool journal_poll(journal_t *j, long *due_us);
+
+/* Statistics of the journal */
+const journal_stats_t *journal_stats(const journal_t *j);
+
+#endif /* LAB0_JOURNAL_H */
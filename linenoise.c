@@ -22,6 +22,7 @@ static char *unsupported_term[] = {"dumb", "cons25", "emacs", NULL};
 static line_completion_callback_t *completion_callback = NULL;
 static line_hints_callback_t *hints_callback = NULL;
 static line_free_hints_callback_t *free_hints_callback = NULL;
+static line_idle_callback_t *idle_callback = NULL;
 
 static struct termios orig_termios; /* In order to restore at exit.*/
 static bool maskmode = false; /* Show "***" instead of input. For passwords. */
@@ -358,6 +359,28 @@ void line_set_completion_callback(line_completion_callback_t *fn)
     completion_callback = fn;
 }
 
+/* Register a function to be called while waiting for input. */
+void line_set_idle_callback(line_idle_callback_t *fn)
+{
+    idle_callback = fn;
+}
+
+/* Like select() on the descriptors in set for reading, but call the idle
+ * callback whenever the time it asked for runs out before any is ready.
+ */
+static int idle_select(int max_fd, fd_set *set)
+{
+    fd_set want = *set;
+    for (;;) {
+        int ms = idle_callback ? idle_callback() : -1;
+        struct timeval tv = {.tv_sec = ms / 1000, .tv_usec = ms % 1000 * 1000};
+        *set = want;
+        int result = select(max_fd + 1, set, NULL, NULL, ms < 0 ? NULL : &tv);
+        if (result)
+            return result;
+    }
+}
+
 /* Register a hits function to be called to show hits to the user at the
  * right of the prompt. */
 void line_set_hints_callback(line_hints_callback_t *fn)
@@ -838,7 +861,7 @@ static int line_edit(int stdin_fd,
         max_fd = max_fd > web_fd ? max_fd : web_fd;
     }
     FD_SET(stdin_fd, &set);
-    int result = select(max_fd + 1, &set, NULL, NULL, NULL);
+    int result = idle_select(max_fd, &set);
     if (result < 0)
         return -1;
 
@@ -863,6 +886,13 @@ static int line_edit(int stdin_fd,
         int nread;
         char seq[5];
 
+        if (idle_callback) {
+            fd_set in;
+            FD_ZERO(&in);
+            FD_SET(l.ifd, &in);
+            if (idle_select(l.ifd, &in) < 0)
+                return l.len;
+        }
         nread = read(l.ifd, &c, 1);
         if (nread <= 0)
             return l.len;
@@ -55,11 +55,18 @@ typedef void(line_completion_callback_t)(const char *, line_completions_t *);
 typedef char *(line_hints_callback_t)(const char *, int *color, int *bold);
 typedef void(line_free_hints_callback_t)(void *);
 void line_set_completion_callback(line_completion_callback_t *);
+
 void line_set_hints_callback(line_hints_callback_t *);
 void line_set_free_hints_callback(line_free_hints_callback_t *);
 void line_add_completion(line_completions_t *, const char *);
 /* clang-format on */
 
+/* Called while waiting for input, returning the milliseconds until it wants
+ * to be called again, or a negative number to wait for input only
+ */
+typedef int(line_idle_callback_t)(void);
+void line_set_idle_callback(line_idle_callback_t *);
+
 void linenoise_webfd(int fd);
 char *linenoise(const char *prompt);
 void line_free(void *ptr);
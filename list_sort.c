@@ -12,6 +12,63 @@
 #define likely(x) __builtin_expect(!!(x), 1)
 #define unlikely(x) __builtin_expect(!!(x), 0)
 
+/* After this many consecutive wins of one input, the merges gallop */
+#define MIN_GALLOP 7
+
+/* Whether node goes before pivot; nodes of input 'a' go first on ties */
+static inline bool goes_before(list_cmp_func_t cmp,
+                               struct list_head *node,
+                               struct list_head *pivot,
+                               bool from_a,
+                               bool descend)
+{
+    return from_a ? cmp(node, pivot, descend) <= 0
+                  : cmp(pivot, node, descend) > 0;
+}
+
+/* Find the last node of the null-terminated run starting at 'first' which
+ * goes before 'pivot', given that 'first' does. Probes at exponentially
+ * growing distances, then bisects, spending O(log k) comparisons on k nodes.
+ */
+__attribute__((nonnull(1, 2, 3))) static struct list_head *gallop(
+    list_cmp_func_t cmp,
+    struct list_head *first,
+    struct list_head *pivot,
+    bool from_a,
+    bool descend)
+{
+    struct list_head *lo = first, *probe = first;
+    size_t step = 1, dist;
+
+    for (;;) {
+        for (dist = 0; dist < step && probe->next; dist++)
+            probe = probe->next;
+        if (!dist)
+            return lo;
+        if (!goes_before(cmp, probe, pivot, from_a, descend))
+            break;
+        lo = probe;
+        if (dist < step)
+            return lo;
+        step <<= 1;
+    }
+
+    /* 'lo' goes before 'pivot', 'probe' does not, dist - 1 nodes between */
+    for (size_t len = dist - 1; len;) {
+        size_t half = (len + 1) / 2;
+        struct list_head *mid = lo;
+        for (size_t i = 0; i < half; i++)
+            mid = mid->next;
+        if (goes_before(cmp, mid, pivot, from_a, descend)) {
+            lo = mid;
+            len -= half;
+        } else {
+            len = half - 1;
+        }
+    }
+    return lo;
+}
+
 __attribute__((nonnull(1, 2, 3))) static struct list_head *merge(
     list_cmp_func_t cmp,
     struct list_head *a,
@@ -19,21 +76,34 @@ __attribute__((nonnull(1, 2, 3))) static struct list_head *merge(
     bool descend)
 {
     struct list_head *head = NULL, **tail = &head;
+    int a_wins = 0, b_wins = 0;
 
     for (;;) {
         /* if equal, take 'a' -- important for sort stability */
         if (cmp(a, b, descend) <= 0) {
+            struct list_head *last = a;
+            b_wins = 0;
+            if (++a_wins >= MIN_GALLOP) {
+                last = gallop(cmp, a, b, true, descend);
+                a_wins = 0;
+            }
             *tail = a;
-            tail = &a->next;
-            a = a->next;
+            tail = &last->next;
+            a = last->next;
             if (!a) {
                 *tail = b;
                 break;
             }
         } else {
+            struct list_head *last = b;
+            a_wins = 0;
+            if (++b_wins >= MIN_GALLOP) {
+                last = gallop(cmp, b, a, false, descend);
+                b_wins = 0;
+            }
             *tail = b;
-            tail = &b->next;
-            b = b->next;
+            tail = &last->next;
+            b = last->next;
             if (!b) {
                 *tail = a;
                 break;
@@ -52,21 +122,38 @@ __attribute__((nonnull(1, 2, 3, 4))) static void merge_final(
 {
     struct list_head *tail = head;
     uint8_t count = 0;
+    int a_wins = 0, b_wins = 0;
 
     for (;;) {
         /* if equal, take 'a' -- important for sort stability */
         if (cmp(a, b, descend) <= 0) {
+            struct list_head *last = a;
+            b_wins = 0;
+            if (++a_wins >= MIN_GALLOP) {
+                last = gallop(cmp, a, b, true, descend);
+                a_wins = 0;
+            }
             tail->next = a;
             a->prev = tail;
-            tail = a;
-            a = a->next;
+            for (; a != last; a = a->next)
+                a->next->prev = a;
+            tail = last;
+            a = last->next;
             if (!a)
                 break;
         } else {
+            struct list_head *last = b;
+            a_wins = 0;
+            if (++b_wins >= MIN_GALLOP) {
+                last = gallop(cmp, b, a, false, descend);
+                b_wins = 0;
+            }
             tail->next = b;
             b->prev = tail;
-            tail = b;
-            b = b->next;
+            for (; b != last; b = b->next)
+                b->next->prev = b;
+            tail = last;
+            b = last->next;
             if (!b) {
                 b = a;
                 break;
@@ -89,12 +176,44 @@ __attribute__((nonnull(1, 2, 3, 4))) static void merge_final(
     head->prev = tail;
 }
 
+/* Detach the natural run at the front of the null-terminated list *listp
+ * and return it null-terminated, advancing *listp past it. A strictly
+ * descending run is reversed on the way; keeping it strict preserves
+ * stability.
+ */
+__attribute__((nonnull(1, 2))) static struct list_head *take_run(
+    list_cmp_func_t cmp,
+    struct list_head **listp,
+    bool descend)
+{
+    struct list_head *run = *listp, *next = run->next;
+
+    if (next && cmp(run, next, descend) > 0) {
+        run->next = NULL;
+        while (next && cmp(run, next, descend) > 0) {
+            struct list_head *after = next->next;
+            next->next = run;
+            run = next;
+            next = after;
+        }
+        *listp = next;
+        return run;
+    }
+
+    struct list_head *tail = run;
+    while (tail->next && cmp(tail, tail->next, descend) <= 0)
+        tail = tail->next;
+    *listp = tail->next;
+    tail->next = NULL;
+    return run;
+}
+
 __attribute__((nonnull(1, 2))) void list_sort(struct list_head *head,
                                               list_cmp_func_t cmp,
                                               bool descend)
 {
     struct list_head *list = head->next, *pending = NULL;
-    size_t count = 0; /* Count of pending */
+    size_t count = 0; /* Count of pending runs */
 
     if (list == head->prev) /* Zero or one elements */
         return;
@@ -119,17 +238,28 @@ __attribute__((nonnull(1, 2))) void list_sort(struct list_head *head,
             *tail = a;
         }
 
-        /* Move one element from input list to pending */
-        list->prev = pending;
-        pending = list;
-        list = list->next;
-        pending->next = NULL;
+        /* Move one natural run from input list to pending */
+        struct list_head *run = take_run(cmp, &list, descend);
+        run->prev = pending;
+        pending = run;
         count++;
     } while (list);
 
     /* End of input; merge together all the pending lists. */
     list = pending;
     pending = pending->prev;
+    if (!pending) {
+        /* The input was a single run: only rebuild the prev links */
+        struct list_head *tail = head;
+        for (; list; list = list->next) {
+            tail->next = list;
+            list->prev = tail;
+            tail = list;
+        }
+        tail->next = head;
+        head->prev = tail;
+        return;
+    }
     for (;;) {
         struct list_head *next = pending->prev;
 
@@ -147,9 +277,14 @@ int cmp(const struct list_head *a, const struct list_head *b, bool descend)
     element_t *a_entry = list_entry(a, element_t, list);
     element_t *b_entry = list_entry(b, element_t, list);
 
+    /* Interned strings are equal exactly when they are the same copy */
+    if (a_entry->value == b_entry->value)
+        return 0;
+
+    /* Positive when 'a' has to go after 'b', as list_sort() expects */
     if (!descend)
-        return strcmp(a_entry->value, b_entry->value) < 0 ? 0 : 1;
+        return strcmp(a_entry->value, b_entry->value);
     else
-        return strcmp(a_entry->value, b_entry->value) > 0 ? 0 : 1;
+        return strcmp(b_entry->value, a_entry->value);
 }
 // EXPORT_SYMBOL(list_sort);
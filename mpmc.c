@@ -0,0 +1,248 @@
+/* Lock-free multi-producer/multi-consumer queue with hazard pointers */
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Worker threads run this code, keep it off the harness like element.c */
+#define INTERNAL 1
+#include "harness.h"
+
+#include "mpmc.h"
+
+#define MQ_CACHE_LINE 64
+
+/**
+ * mq_node_t - A link of the queue
+ * @next: the node behind this one, NULL at the tail
+ * @elem: the element, which belongs to the queue until the node before this
+ *        one is removed; stale in the dummy node at the head
+ */
+typedef struct mq_node {
+    _Atomic(struct mq_node *) next;
+    element_t *elem;
+} mq_node_t;
+
+/**
+ * struct mq_thread - The hazard pointer slot of a thread
+ * @hazard: nodes the thread may dereference, NULL if none
+ * @active: whether a thread has claimed this slot
+ * @q: the queue
+ * @retired: removed nodes waiting to be freed
+ * @nr_retired: number of nodes in @retired
+ *
+ * Each slot starts on a cache line of its own, so publishing a hazard
+ * pointer does not disturb the other threads.
+ */
+struct mq_thread {
+    _Atomic(mq_node_t *) hazard[2];
+    atomic_bool active;
+    mpmc_queue_t *q;
+    mq_node_t *retired[MQ_RETIRE_THRESHOLD];
+    int nr_retired;
+} __attribute__((aligned(MQ_CACHE_LINE)));
+
+/**
+ * struct mpmc_queue - A Michael-Scott queue
+ * @head: the dummy node, whose successor holds the first element
+ * @tail: the last node, or one lagging behind it by a node
+ * @threads: hazard pointer slots
+ *
+ * Producers only swing @tail and consumers only swing @head, so the two are
+ * kept on separate cache lines.
+ */
+struct mpmc_queue {
+    _Atomic(mq_node_t *) head __attribute__((aligned(MQ_CACHE_LINE)));
+    _Atomic(mq_node_t *) tail __attribute__((aligned(MQ_CACHE_LINE)));
+    mq_thread_t threads[MQ_MAX_THREADS];
+};
+
+static mq_node_t *node_new(element_t *elem)
+{
+    mq_node_t *node = malloc(sizeof(mq_node_t));
+    if (!node)
+        return NULL;
+
+    atomic_init(&node->next, NULL);
+    node->elem = elem;
+    return node;
+}
+
+mpmc_queue_t *mq_new()
+{
+    mpmc_queue_t *q = aligned_alloc(MQ_CACHE_LINE, sizeof(mpmc_queue_t));
+    mq_node_t *dummy = node_new(NULL);
+    if (!q || !dummy) {
+        free(q);
+        free(dummy);
+        return NULL;
+    }
+
+    atomic_init(&q->head, dummy);
+    atomic_init(&q->tail, dummy);
+    for (int i = 0; i < MQ_MAX_THREADS; i++) {
+        mq_thread_t *t = &q->threads[i];
+        atomic_init(&t->hazard[0], NULL);
+        atomic_init(&t->hazard[1], NULL);
+        atomic_init(&t->active, false);
+        t->q = q;
+        t->nr_retired = 0;
+    }
+    return q;
+}
+
+void mq_free(mpmc_queue_t *q)
+{
+    if (!q)
+        return;
+
+    mq_node_t *node = atomic_load(&q->head), *next;
+    for (bool dummy = true; node; node = next, dummy = false) {
+        next = atomic_load(&node->next);
+        if (!dummy)
+            element_free(node->elem);
+        free(node);
+    }
+    for (int i = 0; i < MQ_MAX_THREADS; i++) {
+        for (int j = 0; j < q->threads[i].nr_retired; j++)
+            free(q->threads[i].retired[j]);
+    }
+    free(q);
+}
+
+mq_thread_t *mq_attach(mpmc_queue_t *q)
+{
+    for (int i = 0; i < MQ_MAX_THREADS; i++) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&q->threads[i].active, &expected,
+                                           true))
+            return &q->threads[i];
+    }
+    return NULL;
+}
+
+/* Free the retired nodes of t which no thread holds a hazard pointer to */
+static void mq_scan(mq_thread_t *t)
+{
+    mq_node_t *hazards[2 * MQ_MAX_THREADS];
+    int n = 0;
+
+    for (int i = 0; i < MQ_MAX_THREADS; i++) {
+        for (int j = 0; j < 2; j++) {
+            mq_node_t *p = atomic_load(&t->q->threads[i].hazard[j]);
+            if (p)
+                hazards[n++] = p;
+        }
+    }
+
+    int kept = 0;
+    for (int i = 0; i < t->nr_retired; i++) {
+        mq_node_t *node = t->retired[i];
+        bool hazardous = false;
+        for (int j = 0; !hazardous && j < n; j++)
+            hazardous = hazards[j] == node;
+        if (hazardous)
+            t->retired[kept++] = node;
+        else
+            free(node);
+    }
+    t->nr_retired = kept;
+}
+
+/* At most 2 * MQ_MAX_THREADS nodes survive a scan, so there is always room
+ * left after one.
+ */
+static void mq_retire(mq_thread_t *t, mq_node_t *node)
+{
+    if (t->nr_retired == MQ_RETIRE_THRESHOLD)
+        mq_scan(t);
+    t->retired[t->nr_retired++] = node;
+}
+
+void mq_detach(mq_thread_t *t)
+{
+    atomic_store(&t->hazard[0], NULL);
+    atomic_store(&t->hazard[1], NULL);
+    mq_scan(t);
+    atomic_store(&t->active, false);
+}
+
+bool mq_insert_tail(mq_thread_t *t, const char *s)
+{
+    mpmc_queue_t *q = t->q;
+    element_t *e = element_alloc(s);
+    mq_node_t *node = e ? node_new(e) : NULL;
+    if (!node) {
+        element_free(e);
+        return false;
+    }
+
+    mq_node_t *tail;
+    for (;;) {
+        tail = atomic_load(&q->tail);
+        atomic_store(&t->hazard[0], tail);
+        if (tail != atomic_load(&q->tail))
+            continue;
+
+        mq_node_t *next = atomic_load(&tail->next);
+        if (tail != atomic_load(&q->tail))
+            continue;
+        if (next) {
+            /* Help a producer which linked its node but is yet to swing */
+            atomic_compare_exchange_weak(&q->tail, &tail, next);
+            continue;
+        }
+
+        mq_node_t *expected = NULL;
+        if (atomic_compare_exchange_weak(&tail->next, &expected, node))
+            break;
+    }
+    atomic_compare_exchange_strong(&q->tail, &tail, node);
+    atomic_store(&t->hazard[0], NULL);
+    return true;
+}
+
+element_t *mq_remove_head(mq_thread_t *t, char *sp, size_t bufsize)
+{
+    mpmc_queue_t *q = t->q;
+    mq_node_t *head, *next;
+    element_t *e;
+
+    for (;;) {
+        head = atomic_load(&q->head);
+        atomic_store(&t->hazard[0], head);
+        if (head != atomic_load(&q->head))
+            continue;
+
+        mq_node_t *tail = atomic_load(&q->tail);
+        next = atomic_load(&head->next);
+        atomic_store(&t->hazard[1], next);
+        if (head != atomic_load(&q->head))
+            continue;
+
+        if (!next) {
+            e = NULL;
+            break;
+        }
+        if (head == tail) {
+            atomic_compare_exchange_weak(&q->tail, &tail, next);
+            continue;
+        }
+
+        /* next is protected, and its element is ours if the swing succeeds */
+        e = next->elem;
+        if (atomic_compare_exchange_weak(&q->head, &head, next))
+            break;
+    }
+    atomic_store(&t->hazard[0], NULL);
+    atomic_store(&t->hazard[1], NULL);
+    if (!e)
+        return NULL;
+
+    mq_retire(t, head);
+    if (sp) {
+        strncpy(sp, e->value, bufsize);
+        sp[bufsize - 1] = '\0';
+    }
+    return e;
+}
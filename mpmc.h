@@ -0,0 +1,66 @@
+#ifndef LAB0_MPMC_H
+#define LAB0_MPMC_H
+
+/* Lock-free multi-producer/multi-consumer queue.
+ *
+ * A Michael-Scott queue: a singly-linked list of nodes starting at a dummy
+ * node, with the head and the tail swung forward by compare-and-swap. Any
+ * number of threads may insert at the tail and remove from the head at the
+ * same time, and none of them ever waits for another one to leave a
+ * critical section.
+ *
+ * A removed node may still be read by a thread which loaded a pointer to it
+ * just before. Nodes are therefore reclaimed with hazard pointers: every
+ * thread publishes the nodes it is about to dereference in a slot of its
+ * own, and a removed node is only freed once no slot refers to it. Threads
+ * claim a slot with mq_attach() before using the queue.
+ *
+ * The queue carries element_t values from element_alloc().
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "element.h"
+
+/* Most threads attached to one queue at a time */
+#define MQ_MAX_THREADS 64
+
+/* Removed nodes a thread collects before scanning the hazard pointers */
+#define MQ_RETIRE_THRESHOLD (4 * MQ_MAX_THREADS)
+
+typedef struct mpmc_queue mpmc_queue_t;
+typedef struct mq_thread mq_thread_t;
+
+/* Create an empty queue, NULL for allocation failed */
+mpmc_queue_t *mq_new();
+
+/* Free the queue and every element left in it, no effect if q is NULL.
+ * No thread may be using the queue any more.
+ */
+void mq_free(mpmc_queue_t *q);
+
+/* Claim a hazard pointer slot for the calling thread.
+ * Return NULL if MQ_MAX_THREADS threads are attached already.
+ */
+mq_thread_t *mq_attach(mpmc_queue_t *q);
+
+/* Give up the slot of a thread. Nodes it removed and could not free yet are
+ * handed over to the next thread attaching to the slot, or to mq_free().
+ */
+void mq_detach(mq_thread_t *t);
+
+/* Insert an element holding a copy of s at the tail of queue.
+ * Return false for allocation failed.
+ */
+bool mq_insert_tail(mq_thread_t *t, const char *s);
+
+/* Remove the element at the head of queue, like q_remove_head(): if sp is
+ * non-NULL, its string is copied to it, with at most bufsize - 1 characters
+ * plus a null terminator. The caller releases the element with
+ * element_free().
+ * Return NULL if the queue is empty.
+ */
+element_t *mq_remove_head(mq_thread_t *t, char *sp, size_t bufsize);
+
+#endif /* LAB0_MPMC_H */
@@ -0,0 +1,223 @@
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+
+#include "psort.h"
+#include "queue.h"
+
+/**
+ * psort_task_t - A segment of the list and the work pending on it
+ * @list: header of the segment
+ * @right: segment to merge into @list, or NULL to sort @list
+ * @descend: whether or not to sort in descending order
+ */
+typedef struct {
+    struct list_head list;
+    struct list_head *right;
+    bool descend;
+} psort_task_t;
+
+/**
+ * pmerge_round_t - One round of pairwise merges over a chain of queues
+ * @chain: header of the chain of queue_contex_t
+ * @stride: distance in the chain between the two queues of a pair
+ * @pairs: number of pairs in this round
+ * @next: index of the next pair to be claimed by a worker
+ * @descend: whether the queues are sorted in descending order
+ */
+typedef struct {
+    struct list_head *chain;
+    int stride;
+    int pairs;
+    atomic_int next;
+    bool descend;
+} pmerge_round_t;
+
+/* Block SIGALRM and SIGINT for a whole parallel section, saving the mask in
+ * old. The time limit of the harness jumps out of the calling thread, and
+ * doing so while workers still relink the lists, or between two rounds while
+ * the elements sit in segments on the stack, would leave the queues half
+ * done and the threads running. A limit expiring meanwhile is delivered by
+ * unblock_signals() once every worker is joined.
+ */
+static void block_signals(sigset_t *old)
+{
+    sigset_t block;
+    sigemptyset(&block);
+    sigaddset(&block, SIGALRM);
+    sigaddset(&block, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &block, old);
+}
+
+static void unblock_signals(const sigset_t *old)
+{
+    pthread_sigmask(SIG_SETMASK, old, NULL);
+}
+
+/* Call fn on each of the count arguments in parallel, the calling thread
+ * taking the first one itself, and join every worker. The workers inherit
+ * the signal mask of block_signals().
+ */
+static void run_parallel(void *(*fn)(void *), void **args, int count)
+{
+    pthread_t threads[PSORT_MAX_THREADS];
+    bool spawned[PSORT_MAX_THREADS];
+
+    for (int i = 1; i < count; i++)
+        spawned[i] = !pthread_create(&threads[i], NULL, fn, args[i]);
+
+    /* Whatever could not get a thread is done here */
+    fn(args[0]);
+    for (int i = 1; i < count; i++) {
+        if (spawned[i])
+            pthread_join(threads[i], NULL);
+        else
+            fn(args[i]);
+    }
+}
+
+static void *psort_work(void *arg)
+{
+    psort_task_t *task = arg;
+
+    if (!task->right) {
+        sort_list(&task->list, task->descend);
+        return NULL;
+    }
+
+    LIST_HEAD(merged);
+    merge2list(&task->list, task->right, &merged, task->descend);
+    list_splice(&merged, &task->list);
+    return NULL;
+}
+
+void psort(struct list_head *head, int n, int threads, bool descend)
+{
+    if (threads > PSORT_MAX_THREADS)
+        threads = PSORT_MAX_THREADS;
+    if (threads > n / PSORT_MIN_SEGMENT)
+        threads = n / PSORT_MIN_SEGMENT;
+    if (threads < 2) {
+        q_sort(head, descend);
+        return;
+    }
+
+    /* Stale before the first node moves, and sorted the way it is linked */
+    q_reordered(head);
+    descend = descend != q_reversed(head);
+
+    psort_task_t tasks[PSORT_MAX_THREADS];
+    void *round[PSORT_MAX_THREADS];
+    sigset_t old;
+    block_signals(&old);
+
+    /* Cut the list into segments, the first n % threads one longer */
+    for (int i = 0; i < threads; i++) {
+        psort_task_t *task = &tasks[i];
+        INIT_LIST_HEAD(&task->list);
+        task->right = NULL;
+        task->descend = descend;
+        round[i] = task;
+
+        if (i == threads - 1) {
+            list_splice_init(head, &task->list);
+            break;
+        }
+
+        struct list_head *last = head;
+        for (int len = n / threads + (i < n % threads); len; len--)
+            last = last->next;
+        list_cut_position(&task->list, head, last);
+    }
+    run_parallel(psort_work, round, threads);
+
+    /* Merge neighbouring segments, halving their number every round */
+    for (int stride = 1; stride < threads; stride <<= 1) {
+        int count = 0;
+        for (int i = 0; i + stride < threads; i += stride << 1) {
+            tasks[i].right = &tasks[i + stride].list;
+            round[count++] = &tasks[i];
+        }
+        run_parallel(psort_work, round, count);
+    }
+
+    list_splice(&tasks[0].list, head);
+    unblock_signals(&old);
+}
+
+/* Merge the queue of right into the one of left, which comes first */
+static void merge_pair(queue_contex_t *left,
+                       queue_contex_t *right,
+                       bool descend)
+{
+    queue_head_t *l = list_entry(left->q, queue_head_t, head);
+    queue_head_t *r = list_entry(right->q, queue_head_t, head);
+
+    LIST_HEAD(merged);
+    merge2list(&l->head, &r->head, &merged, descend);
+    list_splice(&merged, &l->head);
+    l->size += r->size;
+    r->size = 0;
+    q_reordered(&l->head);
+    q_reordered(&r->head);
+}
+
+/* Claim pairs of the round until none is left. Pairs are claimed in
+ * increasing order, so each worker walks the chain only once per round.
+ */
+static void *pmerge_work(void *arg)
+{
+    pmerge_round_t *round = arg;
+    struct list_head *cur = round->chain->next;
+    int pos = 0;
+
+    for (int pair; (pair = atomic_fetch_add(&round->next, 1)) < round->pairs;) {
+        for (; pos < 2 * pair * round->stride; pos++)
+            cur = cur->next;
+
+        struct list_head *right = cur;
+        for (int i = 0; i < round->stride; i++)
+            right = right->next;
+
+        merge_pair(list_entry(cur, queue_contex_t, chain),
+                   list_entry(right, queue_contex_t, chain), round->descend);
+    }
+    return NULL;
+}
+
+int pmerge(struct list_head *head, int threads, bool descend)
+{
+    if (!head || list_empty(head))
+        return 0;
+
+    int k = 0;
+    queue_contex_t *ctx = NULL;
+    list_for_each_entry (ctx, head, chain) {
+        q_normalize(ctx->q);
+        k++;
+    }
+
+    if (threads > PSORT_MAX_THREADS)
+        threads = PSORT_MAX_THREADS;
+    if (threads < 2 || k < 3)
+        return q_merge(head, descend);
+
+    void *args[PSORT_MAX_THREADS];
+    pmerge_round_t round = {.chain = head, .descend = descend};
+    sigset_t old;
+    block_signals(&old);
+
+    for (int stride = 1; stride < k; stride <<= 1) {
+        round.stride = stride;
+        round.pairs = (k - stride + 2 * stride - 1) / (2 * stride);
+        atomic_init(&round.next, 0);
+
+        int count = threads < round.pairs ? threads : round.pairs;
+        for (int i = 0; i < count; i++)
+            args[i] = &round;
+        run_parallel(pmerge_work, args, count);
+    }
+    unblock_signals(&old);
+
+    return q_size(list_first_entry(head, queue_contex_t, chain)->q);
+}
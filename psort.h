@@ -0,0 +1,52 @@
+#ifndef LAB0_PSORT_H
+#define LAB0_PSORT_H
+
+#include <stdbool.h>
+
+#include "list.h"
+
+/* Upper bound of worker threads used by psort() */
+#define PSORT_MAX_THREADS 64
+
+/* Segments shorter than this are not worth a thread of their own */
+#define PSORT_MIN_SEGMENT 4096
+
+/**
+ * psort() - Sort a queue on several threads
+ * @head: header of queue
+ * @n: number of elements in the queue
+ * @threads: number of threads to use
+ * @descend: whether or not to sort in descending order
+ *
+ * The list is cut into @threads segments of about equal length with
+ * list_cut_position(), and every segment is sorted by sort_list() on a thread
+ * of its own. The sorted segments are then merged pairwise in rounds, each
+ * round running its merges in parallel, like the levels of a merge tree.
+ *
+ * The result is the one q_sort() gives, including the order of equal values,
+ * and like q_sort() it takes care of a pending lazy reversal and of the index.
+ * The per-thread state lives on the caller's stack, so nothing is allocated
+ * through the harness and only the existing nodes are relinked. Short queues,
+ * or @threads below 2, are sorted by q_sort() directly.
+ */
+void psort(struct list_head *head, int n, int threads, bool descend);
+
+/**
+ * pmerge() - Merge all the queues of a chain on several threads
+ * @head: header of the chain of queue_contex_t
+ * @threads: number of threads to use
+ * @descend: whether to merge queues sorted in descending order
+ *
+ * Same contract as q_merge(): the sorted queues are merged into the first
+ * one and the others are left empty, without allocating. The queues are
+ * merged pairwise in log2(k) rounds for k queues; in each round, queue i
+ * absorbs queue i + stride for every i at a multiple of 2 * stride, and the
+ * pairs are handed out to @threads workers. Ties are resolved in chain
+ * order, so the result is the one q_merge() gives. Chains of fewer than three
+ * queues, or @threads below 2, are merged by q_merge() directly.
+ *
+ * Return: the number of elements in the first queue after merging
+ */
+int pmerge(struct list_head *head, int threads, bool descend);
+
+#endif /* LAB0_PSORT_H */
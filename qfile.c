@@ -0,0 +1,294 @@
+/* On-disk format of a queue, loaded without copying the strings */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "qfile.h"
+#include "queue.h"
+
+/* Initial capacity of the table of mapped files */
+#define IMAGES_MIN 16
+
+/**
+ * qfile_image_t - A file mapped by qfile_load()
+ * @base: start of the mapping
+ * @len: length of the mapping
+ * @refs: elements pointing into the mapping
+ */
+typedef struct {
+    uintptr_t base;
+    size_t len;
+    size_t refs;
+} qfile_image_t;
+
+/* The mapped files sorted by address. The table lives outside the harness,
+ * it is not owned by any queue, and it is kept at its largest size.
+ */
+static qfile_image_t *images;
+static int nr_images, max_images;
+
+/* Position of the first image starting above address p */
+static int image_after(uintptr_t p)
+{
+    int lo = 0, hi = nr_images;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (images[mid].base <= p)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Add the mapping of len bytes at base, returning its position or -1 with
+ * errno set if the table could not grow
+ */
+static int image_add(void *base, size_t len)
+{
+    if (nr_images == max_images) {
+        int max = max_images ? 2 * max_images : IMAGES_MIN;
+        qfile_image_t *table = realloc(images, max * sizeof(qfile_image_t));
+        if (!table) {
+            errno = ENOMEM;
+            return -1;
+        }
+        images = table;
+        max_images = max;
+    }
+
+    int i = image_after((uintptr_t) base);
+    memmove(&images[i + 1], &images[i], (nr_images - i) * sizeof(*images));
+    images[i] = (qfile_image_t){.base = (uintptr_t) base, .len = len};
+    nr_images++;
+    return i;
+}
+
+/* Unmap image i and forget about it */
+static void image_drop(int i)
+{
+    munmap((void *) images[i].base, images[i].len);
+    nr_images--;
+    memmove(&images[i], &images[i + 1], (nr_images - i) * sizeof(*images));
+}
+
+bool qfile_put(const char *s)
+{
+    uintptr_t p = (uintptr_t) s;
+    int i = image_after(p) - 1;
+    if (i < 0 || p - images[i].base >= images[i].len)
+        return false;
+    if (!--images[i].refs)
+        image_drop(i);
+    return true;
+}
+
+/* Step through a queue from its head to its tail, whether or not it is
+ * lazily reversed.
+ */
+static inline struct list_head *step(struct list_head *node, bool reversed)
+{
+    return reversed ? node->prev : node->next;
+}
+
+/* Write the queue in the file format to f */
+static bool write_queue(FILE *f, struct list_head *head)
+{
+    bool rev = q_reversed(head);
+    uint64_t blob_size = 0;
+    for (struct list_head *node = step(head, rev); node != head;
+         node = step(node, rev))
+        blob_size += strlen(list_entry(node, element_t, list)->value) + 1;
+
+    qfile_header_t h = {
+        .magic = QFILE_MAGIC,
+        .version = QFILE_VERSION,
+        .flags = blob_size > UINT32_MAX ? QFILE_WIDE : 0,
+        .count = q_size(head),
+        .blob_size = blob_size,
+    };
+    if (fwrite(&h, sizeof(h), 1, f) != 1)
+        return false;
+
+    uint64_t off = 0;
+    for (struct list_head *node = step(head, rev); node != head;
+         node = step(node, rev)) {
+        uint32_t narrow = off;
+        bool ok = h.flags & QFILE_WIDE ? fwrite(&off, sizeof(off), 1, f)
+                                       : fwrite(&narrow, sizeof(narrow), 1, f);
+        if (!ok)
+            return false;
+        off += strlen(list_entry(node, element_t, list)->value) + 1;
+    }
+
+    for (struct list_head *node = step(head, rev); node != head;
+         node = step(node, rev)) {
+        const char *value = list_entry(node, element_t, list)->value;
+        if (fputs(value, f) == EOF || fputc('\0', f) == EOF)
+            return false;
+    }
+    return true;
+}
+
+bool qfile_save(struct list_head *head, const char *path)
+{
+    if (!head || !path) {
+        errno = EINVAL;
+        return false;
+    }
+
+    char tmp[PATH_MAX];
+    if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= (int) sizeof(tmp)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+
+    int fd = mkstemp(tmp);
+    if (fd < 0)
+        return false;
+    FILE *f = fdopen(fd, "w");
+    if (!f) {
+        int err = errno;
+        close(fd);
+        unlink(tmp);
+        errno = err;
+        return false;
+    }
+
+    bool ok = write_queue(f, head) && !fflush(f) && !fsync(fd) &&
+              !fchmod(fd, 0644);
+    int err = errno;
+    ok = !fclose(f) && ok;
+    if (ok && !rename(tmp, path))
+        return true;
+
+    err = ok ? errno : err;
+    unlink(tmp);
+    errno = err;
+    return false;
+}
+
+/* Check the header of a mapped file of len bytes, returning the size of an
+ * offset, or zero with errno set if the file cannot be loaded into head.
+ */
+static size_t check_header(const qfile_header_t *h,
+                           size_t len,
+                           struct list_head *head)
+{
+    errno = EINVAL;
+    if (len < sizeof(*h) || memcmp(h->magic, QFILE_MAGIC, sizeof(h->magic)) ||
+        h->version != QFILE_VERSION || (h->flags & ~QFILE_WIDE))
+        return 0;
+
+    size_t width = h->flags & QFILE_WIDE ? sizeof(uint64_t) : sizeof(uint32_t);
+    size_t body = len - sizeof(*h);
+    if (h->count > body / width || h->blob_size != body - h->count * width ||
+        (h->count && !h->blob_size))
+        return 0;
+
+    /* Every string ends within the blob if the blob ends with a NUL */
+    const char *blob = (const char *) (h + 1) + h->count * width;
+    if (h->blob_size && blob[h->blob_size - 1])
+        return 0;
+
+    if (h->count > (uint64_t) (INT_MAX - q_size(head))) {
+        errno = EOVERFLOW;
+        return 0;
+    }
+    return width;
+}
+
+bool qfile_load(struct list_head *head, const char *path)
+{
+    if (!head || !path) {
+        errno = EINVAL;
+        return false;
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st)) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return false;
+    }
+    if (st.st_size < (off_t) sizeof(qfile_header_t)) {
+        close(fd);
+        errno = EINVAL;
+        return false;
+    }
+
+    void *base =
+        mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    close(fd);
+    if (base == MAP_FAILED) {
+        errno = err;
+        return false;
+    }
+
+    const qfile_header_t *h = base;
+    size_t width = check_header(h, st.st_size, head);
+    if (!width || !h->count) {
+        err = errno;
+        munmap(base, st.st_size);
+        errno = err;
+        return width != 0;
+    }
+
+    int img = image_add(base, st.st_size);
+    if (img < 0) {
+        err = errno;
+        munmap(base, st.st_size);
+        errno = err;
+        return false;
+    }
+
+    const char *offsets = (const char *) (h + 1);
+    char *blob = (char *) offsets + h->count * width;
+    LIST_HEAD(list);
+    uint64_t i;
+    for (i = 0; i < h->count; i++) {
+        uint64_t off = width == sizeof(uint64_t)
+                           ? ((const uint64_t *) offsets)[i]
+                           : ((const uint32_t *) offsets)[i];
+        if (off >= h->blob_size) {
+            errno = EINVAL;
+            break;
+        }
+
+        element_t *e = malloc(sizeof(element_t) + 1);
+        if (!e) {
+            errno = ENOMEM;
+            break;
+        }
+        e->data[0] = ELEMENT_MAPPED;
+        e->value = blob + off;
+        images[img].refs++;
+        list_add_tail(&e->list, &list);
+    }
+
+    if (i < h->count) {
+        /* The last reference, if any, unmaps the file */
+        err = errno;
+        if (!images[img].refs)
+            image_drop(img);
+        element_t *entry = NULL, *safe = NULL;
+        list_for_each_entry_safe (entry, safe, &list, list)
+            q_release_element(entry);
+        errno = err;
+        return false;
+    }
+
+    return q_splice_tail(head, &list, h->count);
+}
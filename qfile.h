@@ -0,0 +1,88 @@
+#ifndef LAB0_QFILE_H
+#define LAB0_QFILE_H
+
+/* On-disk format of a queue, loaded without copying the strings.
+ *
+ * A file holds, in the byte order of the host:
+ *
+ *   header    magic "lab0-q\n", version, flags, element count, blob size
+ *   offsets   the offset of every string in the blob, from the head of the
+ *             queue to its tail, 32 bits wide or 64 bits with QFILE_WIDE
+ *   blob      the strings, each followed by its NUL terminator
+ *
+ * Loading maps the file privately and links an element_t for each string
+ * whose value points straight into the mapping, so only the offsets are read
+ * up front and the strings are paged in when first touched. Values can be
+ * written to like any other, which copies the page and leaves the file as it
+ * is. The mapping is counted as referenced by its elements and unmapped when
+ * the last one is released through q_release_element().
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "list.h"
+
+#define QFILE_MAGIC "lab0-q\n"
+#define QFILE_VERSION 1
+
+/* The offsets are 64 bits wide */
+#define QFILE_WIDE 0x1
+
+/**
+ * qfile_header_t - Header at the start of a queue file
+ * @magic: QFILE_MAGIC with its NUL terminator
+ * @version: QFILE_VERSION
+ * @flags: QFILE_WIDE or zero
+ * @count: number of strings
+ * @blob_size: bytes of the strings, terminators included
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t count;
+    uint64_t blob_size;
+} qfile_header_t;
+
+/**
+ * qfile_save() - Write a queue to a file
+ * @head: header of queue
+ * @path: the file, replaced as a whole
+ *
+ * The queue is written to a temporary file next to @path, flushed to disk
+ * and renamed over @path, so a crash leaves either the old file or the new
+ * one. Elements loaded from @path itself keep the old contents.
+ *
+ * Return: true for success, false with errno set if the file could not be
+ * written or queue is NULL
+ */
+bool qfile_save(struct list_head *head, const char *path);
+
+/**
+ * qfile_load() - Append the strings of a file to a queue
+ * @head: header of queue
+ * @path: the file
+ *
+ * The elements point into a mapping of the file rather than holding copies
+ * of the strings, and are inserted at the tail of the queue in the order
+ * they were saved. Either all of them are inserted, or the queue is left
+ * untouched.
+ *
+ * Return: true for success, false with errno set if the file could not be
+ * mapped, is not a valid queue file, or holds too many strings, or if an
+ * element could not be allocated
+ */
+bool qfile_load(struct list_head *head, const char *path);
+
+/**
+ * qfile_put() - Drop the reference of an element on the file it points into
+ * @s: the value of the element
+ *
+ * The file is unmapped with the last reference.
+ *
+ * Return: true if @s lies in a mapped file, false if it does not
+ */
+bool qfile_put(const char *s);
+
+#endif /* LAB0_QFILE_H */
@@ -44,10 +44,19 @@ extern int show_entropy;
  * solution code
  */
 #include "agents/negamax.h"
+#include "bench.h"
+#include "extsort.h"
 #include "game.h"
+#include "intern.h"
+#include "journal.h"
 #include "list_sort.h"
+#include "mpmc.h"
+#include "psort.h"
+#include "qfile.h"
 #include "queue.h"
+#include "radix_sort.h"
 #include "shuffle.h"
+#include "snapshot.h"
 
 #include "console.h"
 #include "report.h"
@@ -81,6 +90,43 @@ static int string_length = MAXSTRING;
 
 static int descend = 0;
 
+/* Algorithm behind the sort command */
+typedef enum {
+    SORT_MERGE,
+    SORT_RADIX,
+} sort_algo_t;
+static int sort_algo = SORT_MERGE;
+
+/* Threads used by the merge sort of sort and by merge */
+static int sort_threads = 1;
+
+/* Memory budget of extsort in KiB */
+static int ext_budget = EXTSORT_BUDGET >> 10;
+
+/* Journal of the queue journal_q, and when it commits its records */
+static journal_t *journal = NULL;
+static struct list_head *journal_q = NULL;
+static int journal_batch = 1;
+static int journal_delay = 0;
+
+/* Background save in progress or not reported yet, if any */
+static snapshot_t *bgsave = NULL;
+
+/* Cross-check cached queue sizes against a full list walk */
+static int debug_mode = 0;
+
+/* Run the constant-time simulation against the ring-buffer deque */
+static int sim_ring = 0;
+
+/* Validate every inserted element, instead of inserting in bulk */
+static int validate = 1;
+
+/* Pool small blocks of the harness instead of handing them back to libc */
+static int pool_mode = 0;
+
+/* How many strings are handed to the bulk insertion at once */
+#define BULK_CHUNK 1024
+
 #define MIN_RANDSTR_LEN 5
 #define MAX_RANDSTR_LEN 10
 static const char charset[] = "abcdefghijklmnopqrstuvwxyz";
@@ -92,6 +138,80 @@ typedef enum {
 /* Forward declarations */
 static bool q_show(int vlevel);
 
+/* Next node of the current queue from head to tail, honouring a pending
+ * lazy reversal. Stepping from the header gives the first element.
+ */
+static inline struct list_head *q_step(struct list_head *node)
+{
+    return q_reversed(current->q) ? node->prev : node->next;
+}
+
+/* Append an operation done on the current queue to its journal, if any */
+static bool jlog(journal_op_t op, int arg, const char *s)
+{
+    if (!journal || !current || current->q != journal_q)
+        return true;
+    if (journal_log(journal, op, arg, s))
+        return true;
+    report(1, "ERROR: Could not write journal: %s", strerror(errno));
+    return false;
+}
+
+/* Journal the whole current queue, after an operation which cannot be
+ * replayed
+ */
+static bool jlog_contents(void)
+{
+    if (!journal || !current || current->q != journal_q)
+        return true;
+    if (journal_log_contents(journal, current->q))
+        return true;
+    report(1, "ERROR: Could not write journal: %s", strerror(errno));
+    return false;
+}
+
+/* Commit and close the journal of queue q, if it has one */
+static bool journal_detach(struct list_head *q)
+{
+    if (!journal || q != journal_q)
+        return true;
+    bool ok = journal_close(journal);
+    if (!ok)
+        report(1, "ERROR: Could not commit journal: %s", strerror(errno));
+    journal = NULL;
+    journal_q = NULL;
+    return ok;
+}
+
+static void pool_mode_changed(int oldval)
+{
+    if (set_pool_mode(pool_mode))
+        return;
+    report(1,
+           "ERROR: The pool can only change with no block allocated, and "
+           "cannot be used under a sanitizer or valgrind");
+    pool_mode = oldval;
+}
+
+static void journal_commit_changed(int oldval)
+{
+    if (journal && !journal_set_commit(journal, journal_batch, journal_delay))
+        report(1, "ERROR: Could not commit journal: %s", strerror(errno));
+}
+
+/* Commit a journal group whose delay runs out while no command comes in */
+static int journal_idle(void)
+{
+    long due_us;
+    if (!journal)
+        return -1;
+    if (!journal_poll(journal, &due_us)) {
+        report(1, "ERROR: Could not commit journal: %s", strerror(errno));
+        return -1;
+    }
+    return due_us < 0 ? -1 : (int) ((due_us + 999) / 1000);
+}
+
 static int move_record[N_GRIDS];
 static int move_count = 0;
 
@@ -269,18 +389,20 @@ bool do_lsort(int argc, char *argv[])
 
     set_noallocate_mode(true);
     if (current && exception_setup(true))
-        list_sort(current->q, cmp, descend);
+        list_sort(current->q, cmp, descend != q_reversed(current->q));
     exception_cancel();
+    if (current)
+        q_reordered(current->q);
     set_noallocate_mode(false);
 
-    bool ok = true;
+    bool ok = jlog(JOURNAL_SORT, descend, NULL);
     if (current && current->size) {
-        for (struct list_head *cur_l = current->q->next;
-             cur_l != current->q && --cnt; cur_l = cur_l->next) {
+        for (struct list_head *cur_l = q_step(current->q);
+             cur_l != current->q && --cnt; cur_l = q_step(cur_l)) {
             /* Ensure each element in ascending/descending order */
             element_t *item, *next_item;
             item = list_entry(cur_l, element_t, list);
-            next_item = list_entry(cur_l->next, element_t, list);
+            next_item = list_entry(q_step(cur_l), element_t, list);
             if (!descend && strcmp(item->value, next_item->value) > 0) {
                 report(1, "ERROR: Not sorted in ascending order");
                 ok = false;
@@ -312,10 +434,14 @@ static bool do_shuffle(int argc, char *argv[])
     if (q_size(current->q) < 2)
         report(3, "Warning: Calling shuffle on single queue");
     error_check();
-    if (exception_setup(true))
+    if (exception_setup(true)) {
         q_shuffle(current->q);
+        q_reordered(current->q);
+    }
+    exception_cancel();
+    bool ok = jlog_contents();
     q_show(3);
-    return !error_check();
+    return ok && !error_check();
 }
 
 static bool do_free(int argc, char *argv[])
@@ -344,6 +470,7 @@ static bool do_free(int argc, char *argv[])
 
     if (current) {
         list_del(&current->chain);
+        ok = journal_detach(current->q);
 
         if (exception_setup(true))
             q_free(current->q);
@@ -410,6 +537,50 @@ static void fill_rand_string(char *buf, size_t buf_size)
     buf[len] = '\0';
 }
 
+/* Insert reps elements through the bulk API, BULK_CHUNK elements at a time */
+static bool queue_insert_bulk(position_t pos,
+                              char *inserts,
+                              bool need_rand,
+                              int reps)
+{
+    static char randstr_bufs[BULK_CHUNK][MAX_RANDSTR_LEN];
+    char *strs[BULK_CHUNK];
+    bool ok = true;
+
+    for (int done = 0; ok && done < reps;) {
+        int n = reps - done < BULK_CHUNK ? reps - done : BULK_CHUNK;
+        for (int i = 0; i < n; i++) {
+            if (need_rand)
+                fill_rand_string(randstr_bufs[i], sizeof(randstr_bufs[i]));
+            strs[i] = need_rand ? randstr_bufs[i] : inserts;
+        }
+
+        bool rval = pos == POS_TAIL ? q_insert_tail_bulk(current->q, strs, n)
+                                    : q_insert_head_bulk(current->q, strs, n);
+        if (rval) {
+            current->size += n;
+            for (int i = 0; ok && i < n; i++)
+                ok = jlog(pos == POS_TAIL ? JOURNAL_INSERT_TAIL
+                                          : JOURNAL_INSERT_HEAD,
+                          0, strs[i]);
+        } else {
+            fail_count++;
+            if (fail_count < fail_limit)
+                report(2, "Insertion of %d elements failed", n);
+            else {
+                report(1,
+                       "ERROR: Insertion of %d elements failed (%d failures "
+                       "total)",
+                       n, fail_count);
+                ok = false;
+            }
+        }
+        done += n;
+        ok = ok && !error_check();
+    }
+    return ok;
+}
+
 /* insertion */
 static bool queue_insert(position_t pos, int argc, char *argv[])
 {
@@ -418,8 +589,13 @@ static bool queue_insert(position_t pos, int argc, char *argv[])
             report(1, "%s does not need arguments in simulation mode", argv[0]);
             return false;
         }
-        bool ok =
-            pos == POS_TAIL ? is_insert_tail_const() : is_insert_head_const();
+        bool ok;
+        if (sim_ring)
+            ok = pos == POS_TAIL ? is_ring_insert_tail_const()
+                                 : is_ring_insert_head_const();
+        else
+            ok = pos == POS_TAIL ? is_insert_tail_const()
+                                 : is_insert_head_const();
         if (!ok) {
             report(1,
                    "ERROR: Probably not constant time or wrong implementation");
@@ -456,7 +632,10 @@ static bool queue_insert(position_t pos, int argc, char *argv[])
                pos == POS_TAIL ? "tail" : "head");
     error_check();
 
-    if (current && exception_setup(true)) {
+    if (current && !validate && reps > 1) {
+        if (exception_setup(true))
+            ok = queue_insert_bulk(pos, inserts, need_rand, reps);
+    } else if (current && exception_setup(true)) {
         for (int r = 0; ok && r < reps; r++) {
             if (need_rand)
                 fill_rand_string(randstr_buf, sizeof(randstr_buf));
@@ -465,7 +644,7 @@ static bool queue_insert(position_t pos, int argc, char *argv[])
             if (rval) {
                 current->size++;
                 element_t *entry =
-                    pos == POS_TAIL
+                    (pos == POS_TAIL) != q_reversed(current->q)
                         ? list_last_entry(current->q, element_t, list)
                         : list_first_entry(current->q, element_t, list);
                 char *cur_inserts = entry->value;
@@ -478,7 +657,7 @@ static bool queue_insert(position_t pos, int argc, char *argv[])
                            "queue element");
                     ok = false;
                     break;
-                } else if (r == 1 && lasts == cur_inserts) {
+                } else if (r == 1 && lasts == cur_inserts && !intern_mode) {
                     report(1,
                            "ERROR: Need to allocate separate string for each "
                            "queue element");
@@ -486,6 +665,9 @@ static bool queue_insert(position_t pos, int argc, char *argv[])
                     break;
                 }
                 lasts = cur_inserts;
+                ok = ok && jlog(pos == POS_TAIL ? JOURNAL_INSERT_TAIL
+                                                : JOURNAL_INSERT_HEAD,
+                                0, inserts);
             } else {
                 fail_count++;
                 if (fail_count < fail_limit)
@@ -518,6 +700,50 @@ static bool do_it(int argc, char *argv[])
     return queue_insert(POS_TAIL, argc, argv);
 }
 
+/* Remove n elements from head of queue in one step and release them */
+static bool queue_remove_bulk(int n)
+{
+    if (n <= 0) {
+        report(1, "Invalid number of removals '%d'", n);
+        return false;
+    }
+
+    if (!current || !current->size)
+        report(3, "Warning: Calling remove head on empty queue");
+    error_check();
+
+    LIST_HEAD(removed);
+    int cnt = 0;
+    if (current && exception_setup(true))
+        cnt = q_remove_head_n(current->q, n, &removed);
+    exception_cancel();
+
+    bool ok = true;
+    int released = 0;
+    element_t *item = NULL, *tmp = NULL;
+    list_for_each_entry_safe (item, tmp, &removed, list) {
+        q_release_element(item);
+        released++;
+    }
+
+    int expected = current ? (n < current->size ? n : current->size) : 0;
+    if (released != cnt || cnt != expected) {
+        report(1,
+               "ERROR: Removed %d elements and reported %d, but expected %d",
+               released, cnt, expected);
+        ok = false;
+    } else {
+        report(2, "Removed %d elements from queue", cnt);
+    }
+    if (current)
+        current->size -= released;
+    if (cnt)
+        ok = jlog(JOURNAL_REMOVE_HEAD_N, cnt, NULL) && ok;
+
+    q_show(3);
+    return ok && !error_check();
+}
+
 static bool queue_remove(position_t pos, int argc, char *argv[])
 {
     /* FIXME: It is known that both functions is_remove_tail_const() and
@@ -530,8 +756,13 @@ static bool queue_remove(position_t pos, int argc, char *argv[])
             report(1, "%s does not need arguments in simulation mode", argv[0]);
             return false;
         }
-        bool ok =
-            pos == POS_TAIL ? is_remove_tail_const() : is_remove_head_const();
+        bool ok;
+        if (sim_ring)
+            ok = pos == POS_TAIL ? is_ring_remove_tail_const()
+                                 : is_ring_remove_head_const();
+        else
+            ok = pos == POS_TAIL ? is_remove_tail_const()
+                                 : is_remove_head_const();
         if (!ok) {
             report(1,
                    "ERROR: Probably not constant time or wrong implementation");
@@ -591,6 +822,8 @@ static bool queue_remove(position_t pos, int argc, char *argv[])
         // q_remove_head and q_remove_tail are not responsible for releasing
         // node
         q_release_element(re);
+        ok = jlog(pos == POS_TAIL ? JOURNAL_REMOVE_TAIL : JOURNAL_REMOVE_HEAD,
+                  0, NULL);
 
         removes[string_length + STRINGPAD] = '\0';
         if (removes[0] == '\0') {
@@ -647,10 +880,98 @@ static inline bool do_rt(int argc, char *argv[])
     return queue_remove(POS_TAIL, argc, argv);
 }
 
+static bool do_rhn(int argc, char *argv[])
+{
+    int n;
+    if (argc != 2 || !get_int(argv[1], &n)) {
+        report(1, "%s needs a number of elements", argv[0]);
+        return false;
+    }
+    return queue_remove_bulk(n);
+}
+
+/* A string of the queue before dedup, and its position */
+typedef struct {
+    const char *value;
+    int pos;
+} dedup_item_t;
+
+static int dedup_item_cmp(const void *a, const void *b)
+{
+    const dedup_item_t *x = a, *y = b;
+    int cmp = strcmp(x->value, y->value);
+    return cmp ? cmp : x->pos - y->pos;
+}
+
+/* Check the queue against the copy taken before q_delete_dup_unsorted():
+ * sorting the copy by string and position shows how often each string
+ * occurs and where it occurs first.
+ */
+static bool check_dedup_unsorted(struct list_head *copy, int n, bool keep_first)
+{
+    if (!n)
+        return list_empty(current->q);
+
+    dedup_item_t *items = malloc(sizeof(*items) * n);
+    bool *keep = malloc(sizeof(*keep) * n);
+    const char **values = malloc(sizeof(*values) * n);
+    if (!items || !keep || !values) {
+        free(items);
+        free(keep);
+        free(values);
+        report(1, "INTERNAL ERROR.  Could not allocate space for duplicate "
+                  "checking");
+        return false;
+    }
+
+    int i = 0;
+    element_t *item = NULL;
+    list_for_each_entry (item, copy, list) {
+        items[i].value = values[i] = item->value;
+        items[i].pos = i;
+        i++;
+    }
+    qsort(items, n, sizeof(*items), dedup_item_cmp);
+
+    for (int lo = 0, hi; lo < n; lo = hi) {
+        for (hi = lo + 1; hi < n && !strcmp(items[hi].value, items[lo].value);
+             hi++)
+            keep[items[hi].pos] = false;
+        keep[items[lo].pos] = hi - lo == 1 || keep_first;
+    }
+
+    bool ok = true;
+    struct list_head *cur = q_step(current->q);
+    current->size = 0;
+    for (i = 0; ok && i < n; i++) {
+        if (!keep[i])
+            continue;
+        ok = cur != current->q &&
+             !strcmp(list_entry(cur, element_t, list)->value, values[i]);
+        cur = q_step(cur);
+        current->size++;
+    }
+    ok = ok && cur == current->q;
+    if (!ok)
+        report(1,
+               "ERROR: Duplicate strings are in queue or distinct strings are "
+               "not in queue in their original order");
+
+    free(items);
+    free(keep);
+    free(values);
+    return ok;
+}
+
 static bool do_dedup(int argc, char *argv[])
 {
-    if (argc != 1) {
-        report(1, "%s takes no arguments", argv[0]);
+    bool unsorted = false, keep_first = false;
+    if (argc == 2 && !strcmp(argv[1], "all")) {
+        unsorted = true;
+    } else if (argc == 2 && !strcmp(argv[1], "first")) {
+        unsorted = keep_first = true;
+    } else if (argc != 1) {
+        report(1, "%s takes an optional 'all' or 'first'", argv[0]);
         return false;
     }
 
@@ -664,8 +985,10 @@ static bool do_dedup(int argc, char *argv[])
 
     // Copy current->q to l_copy
     if (current->q && !list_empty(current->q)) {
-        list_for_each_entry (item, current->q, list) {
+        struct list_head *cur;
+        for (cur = q_step(current->q); cur != current->q; cur = q_step(cur)) {
             size_t slen;
+            item = list_entry(cur, element_t, list);
             tmp = malloc(sizeof(element_t));
             if (!tmp)
                 break;
@@ -680,7 +1003,7 @@ static bool do_dedup(int argc, char *argv[])
             list_add_tail(&tmp->list, &l_copy);
         }
         // Return false if the loop does not leave properly
-        if (&item->list != current->q) {
+        if (cur != current->q) {
             list_for_each_entry_safe (item, tmp, &l_copy, list) {
                 free(item->value);
                 free(item);
@@ -693,20 +1016,41 @@ static bool do_dedup(int argc, char *argv[])
     }
 
     bool ok = true;
+    int cnt = q_size(current->q);
+    if (cnt > BIG_LIST_SIZE)
+        set_cautious_mode(false);
     if (exception_setup(true))
-        ok = q_delete_dup(current->q);
+        ok = unsorted ? q_delete_dup_unsorted(current->q, keep_first)
+                      : q_delete_dup(current->q);
     exception_cancel();
+    set_cautious_mode(true);
 
+    if (ok)
+        ok = unsorted ? jlog(JOURNAL_DEDUP_UNSORTED, keep_first, NULL)
+                      : jlog(JOURNAL_DEDUP, 0, NULL);
     if (!ok) {
         list_for_each_entry_safe (item, tmp, &l_copy, list) {
             free(item->value);
             free(item);
         }
-        report(1, "ERROR: Calling delete duplicate on null queue");
+        if (unsorted)
+            report(1, "ERROR: Could not allocate the table of strings");
+        else
+            report(1, "ERROR: Calling delete duplicate on null queue");
         return false;
     }
 
-    struct list_head *l_tmp = current->q->next;
+    if (unsorted) {
+        ok = check_dedup_unsorted(&l_copy, cnt, keep_first);
+        list_for_each_entry_safe (item, tmp, &l_copy, list) {
+            free(item->value);
+            free(item);
+        }
+        q_show(3);
+        return ok && !error_check();
+    }
+
+    struct list_head *l_tmp = q_step(current->q);
     bool is_this_dup = false;
     // Compare between new list and old one
     list_for_each_entry (item, &l_copy, list) {
@@ -721,7 +1065,7 @@ static bool do_dedup(int argc, char *argv[])
         } else if (l_tmp != current->q &&
                    strcmp(list_entry(l_tmp, element_t, list)->value,
                           item->value) == 0)
-            l_tmp = l_tmp->next;
+            l_tmp = q_step(l_tmp);
         else
             ok = false;
         is_this_dup = is_next_dup;
@@ -759,8 +1103,9 @@ static bool do_reverse(int argc, char *argv[])
     exception_cancel();
 
     set_noallocate_mode(false);
+    bool ok = jlog(JOURNAL_REVERSE, 0, NULL);
     q_show(3);
-    return !error_check();
+    return ok && !error_check();
 }
 
 static bool do_size(int argc, char *argv[])
@@ -795,6 +1140,20 @@ static bool do_size(int argc, char *argv[])
     }
     exception_cancel();
 
+    if (current && ok && debug_mode) {
+        int walked = 0;
+        struct list_head *cur;
+        list_for_each (cur, current->q)
+            walked++;
+        if (walked != cnt) {
+            report(1,
+                   "ERROR: Cached queue size is %d, but the list holds %d "
+                   "elements",
+                   cnt, walked);
+            ok = false;
+        }
+    }
+
     if (current && ok) {
         if (current->size == cnt) {
             report(2, "Queue size = %d", cnt);
@@ -830,19 +1189,28 @@ bool do_sort(int argc, char *argv[])
     error_check();
 
     set_noallocate_mode(true);
-    if (current && exception_setup(true))
-        q_sort(current->q, descend);
+    if (current && exception_setup(true)) {
+        if (sort_algo == SORT_RADIX) {
+            /* Like list_sort(), radix_sort() knows nothing about queues */
+            q_reordered(current->q);
+            radix_sort(current->q, descend != q_reversed(current->q));
+        } else if (sort_threads > 1) {
+            psort(current->q, cnt, sort_threads, descend);
+        } else {
+            q_sort(current->q, descend);
+        }
+    }
     exception_cancel();
     set_noallocate_mode(false);
 
-    bool ok = true;
+    bool ok = jlog(JOURNAL_SORT, descend, NULL);
     if (current && current->size) {
-        for (struct list_head *cur_l = current->q->next;
-             cur_l != current->q && --cnt; cur_l = cur_l->next) {
+        for (struct list_head *cur_l = q_step(current->q);
+             cur_l != current->q && --cnt; cur_l = q_step(cur_l)) {
             /* Ensure each element in ascending/descending order */
             element_t *item, *next_item;
             item = list_entry(cur_l, element_t, list);
-            next_item = list_entry(cur_l->next, element_t, list);
+            next_item = list_entry(q_step(cur_l), element_t, list);
             if (!descend && strcmp(item->value, next_item->value) > 0) {
                 report(1, "ERROR: Not sorted in ascending order");
                 ok = false;
@@ -878,6 +1246,8 @@ static bool do_dm(int argc, char *argv[])
     if (exception_setup(true))
         ok = q_delete_mid(current->q);
     exception_cancel();
+    if (ok)
+        ok = jlog(JOURNAL_DELETE_MID, 0, NULL);
 
     if (!current->size)
         report(3, "Warning: Try to delete middle node to empty queue");
@@ -887,6 +1257,137 @@ static bool do_dm(int argc, char *argv[])
     return ok && !error_check();
 }
 
+/* Parse the position argument of the positional commands */
+static bool get_position(int argc, char *argv[], int *i)
+{
+    if (argc != 2) {
+        report(1, "%s needs 1 argument", argv[0]);
+        return false;
+    }
+    if (!get_int(argv[1], i) || *i < 0) {
+        report(1, "Invalid position '%s'", argv[1]);
+        return false;
+    }
+    if (!current || !current->q) {
+        report(3, "Warning: Try to access null queue");
+        return false;
+    }
+    if (*i >= current->size) {
+        report(1, "Position %d out of range for queue of size %d", *i,
+               current->size);
+        return false;
+    }
+    return true;
+}
+
+static bool do_index(int argc, char *argv[])
+{
+    int indexed = 1;
+    if (argc > 2 || (argc == 2 && !get_int(argv[1], &indexed))) {
+        report(1, "%s takes an optional 0 or 1", argv[0]);
+        return false;
+    }
+
+    if (!current || !current->q) {
+        report(3, "Warning: Try to access null queue");
+        return false;
+    }
+    error_check();
+
+    bool ok = true;
+    if (exception_setup(true))
+        ok = q_set_indexed(current->q, indexed);
+    exception_cancel();
+
+    if (!ok)
+        report(1, "ERROR: Could not allocate the index");
+    return ok && !error_check();
+}
+
+static bool do_lazyrev(int argc, char *argv[])
+{
+    int lazy = 1;
+    if (argc > 2 || (argc == 2 && !get_int(argv[1], &lazy))) {
+        report(1, "%s takes an optional 0 or 1", argv[0]);
+        return false;
+    }
+
+    if (!current || !current->q) {
+        report(3, "Warning: Try to access null queue");
+        return false;
+    }
+    error_check();
+
+    set_noallocate_mode(true);
+    if (exception_setup(true))
+        q_set_lazy_reverse(current->q, lazy);
+    exception_cancel();
+    set_noallocate_mode(false);
+
+    q_show(3);
+    return !error_check();
+}
+
+static bool do_at(int argc, char *argv[])
+{
+    /* The value expected at the position may follow, as for rh */
+    const char *check = argc == 3 ? argv[2] : NULL;
+    int i;
+    if (!get_position(check ? 2 : argc, argv, &i))
+        return false;
+    error_check();
+
+    element_t *e = NULL;
+    if (exception_setup(true))
+        e = q_at(current->q, i);
+    exception_cancel();
+
+    bool ok = e;
+    if (ok && debug_mode) {
+        struct list_head *cur = q_step(current->q);
+        for (int j = 0; j < i; j++)
+            cur = q_step(cur);
+        if (&e->list != cur) {
+            report(1, "ERROR: q_at(%d) does not return the element at %d", i,
+                   i);
+            ok = false;
+        }
+    }
+
+    if (!e) {
+        report(1, "ERROR: No element returned at position %d", i);
+    } else if (check && strcmp(e->value, check)) {
+        report(1, "ERROR: Element at %d is %s, expected %s", i, e->value,
+               check);
+        ok = false;
+    } else {
+        report(1, "Element at %d: %s", i, e->value);
+    }
+    return ok && !error_check();
+}
+
+static bool do_dat(int argc, char *argv[])
+{
+    int i;
+    if (!get_position(argc, argv, &i))
+        return false;
+    error_check();
+
+    bool ok = true;
+    if (exception_setup(true))
+        ok = q_delete_at(current->q, i);
+    exception_cancel();
+
+    if (ok) {
+        --current->size;
+        ok = jlog(JOURNAL_DELETE_AT, i, NULL);
+    } else {
+        report(1, "ERROR: Could not delete the element at position %d", i);
+    }
+    q_show(3);
+    return ok && !error_check();
+}
+
 static bool do_swap(int argc, char *argv[])
 {
     if (argc != 1) {
@@ -907,8 +1408,9 @@ static bool do_swap(int argc, char *argv[])
 
     set_noallocate_mode(false);
 
+    bool ok = jlog(JOURNAL_SWAP, 0, NULL);
     q_show(3);
-    return !error_check();
+    return ok && !error_check();
 }
 
 
@@ -937,15 +1439,15 @@ static bool do_ascend(int argc, char *argv[])
         current->size = q_ascend(current->q);
     set_noallocate_mode(false);
 
-    bool ok = true;
+    bool ok = jlog(JOURNAL_ASCEND, 0, NULL);
 
     cnt = current->size;
     if (current->size) {
-        for (struct list_head *cur_l = current->q->next;
-             cur_l != current->q && --cnt; cur_l = cur_l->next) {
+        for (struct list_head *cur_l = q_step(current->q);
+             cur_l != current->q && --cnt; cur_l = q_step(cur_l)) {
             element_t *item, *next_item;
             item = list_entry(cur_l, element_t, list);
-            next_item = list_entry(cur_l->next, element_t, list);
+            next_item = list_entry(q_step(cur_l), element_t, list);
             if (strcmp(item->value, next_item->value) > 0) {
                 report(1,
                        "ERROR: At least one node violated the ordering rule");
@@ -984,15 +1486,15 @@ static bool do_descend(int argc, char *argv[])
         current->size = q_descend(current->q);
     set_noallocate_mode(false);
 
-    bool ok = true;
+    bool ok = jlog(JOURNAL_DESCEND, 0, NULL);
 
     cnt = current->size;
     if (current->size) {
-        for (struct list_head *cur_l = current->q->next;
-             cur_l != current->q && --cnt; cur_l = cur_l->next) {
+        for (struct list_head *cur_l = q_step(current->q);
+             cur_l != current->q && --cnt; cur_l = q_step(cur_l)) {
             element_t *item, *next_item;
             item = list_entry(cur_l, element_t, list);
-            next_item = list_entry(cur_l->next, element_t, list);
+            next_item = list_entry(q_step(cur_l), element_t, list);
             if (strcmp(item->value, next_item->value) < 0) {
                 report(1,
                        "ERROR: At least one node violated the ordering rule");
@@ -1032,8 +1534,9 @@ static bool do_reverseK(int argc, char *argv[])
     exception_cancel();
 
     set_noallocate_mode(false);
+    bool ok = jlog(JOURNAL_REVERSE_K, k, NULL);
     q_show(3);
-    return !error_check();
+    return ok && !error_check();
 }
 
 static bool do_merge(int argc, char *argv[])
@@ -1052,35 +1555,41 @@ static bool do_merge(int argc, char *argv[])
     int len = 0;
     set_noallocate_mode(true);
     if (current && exception_setup(true))
-        len = q_merge(&chain.head, descend);
+        len = sort_threads > 1 ? pmerge(&chain.head, sort_threads, descend)
+                               : q_merge(&chain.head, descend);
     exception_cancel();
     set_noallocate_mode(false);
 
-    if (q_size(&chain.head) > 1) {
+    if (chain.size > 1) {
         chain.size = 1;
         current = list_entry(chain.head.next, queue_contex_t, chain);
         current->size = len;
 
+        /* As in do_free(), skip searching a big heap for every header */
+        if (len > BIG_LIST_SIZE)
+            set_cautious_mode(false);
         struct list_head *cur = chain.head.next->next;
         while ((uintptr_t) cur != (uintptr_t) &chain.head) {
             queue_contex_t *ctx = list_entry(cur, queue_contex_t, chain);
             cur = cur->next;
+            journal_detach(ctx->q);
             q_free(ctx->q);
             free(ctx);
         }
+        set_cautious_mode(true);
 
         chain.head.prev = &current->chain;
         current->chain.next = &chain.head;
     }
 
-    bool ok = true;
+    bool ok = jlog_contents();
     if (current && current->size) {
-        for (struct list_head *cur_l = current->q->next;
-             cur_l != current->q && --len; cur_l = cur_l->next) {
+        for (struct list_head *cur_l = q_step(current->q);
+             cur_l != current->q && --len; cur_l = q_step(cur_l)) {
             /* Ensure each element in ascending order */
             element_t *item, *next_item;
             item = list_entry(cur_l, element_t, list);
-            next_item = list_entry(cur_l->next, element_t, list);
+            next_item = list_entry(q_step(cur_l), element_t, list);
             if (!descend && strcmp(item->value, next_item->value) > 0) {
                 report(1,
                        "ERROR: Not sorted in ascending order (It might because "
@@ -1107,6 +1616,375 @@ static bool do_merge(int argc, char *argv[])
     return ok && !error_check();
 }
 
+static bool do_bench(int argc, char *argv[])
+{
+    int n = 100000;
+    if (argc != 2 && argc != 3) {
+        report(1, "%s needs 1-2 arguments", argv[0]);
+        bench_list();
+        return false;
+    }
+
+    if (argc == 3 && (!get_int(argv[2], &n) || n <= 0)) {
+        report(1, "Invalid number of elements '%s'", argv[2]);
+        return false;
+    }
+
+    if (!strcmp(argv[1], "sort"))
+        return bench_sort(n, sort_threads) && !error_check();
+    if (!strcmp(argv[1], "merge"))
+        return bench_merge(n, sort_threads) && !error_check();
+    if (!strcmp(argv[1], "journal"))
+        return bench_journal(n) && !error_check();
+    return bench_run(argv[1], n) && !error_check();
+}
+
+static bool do_mpmc(int argc, char *argv[])
+{
+    int producers, consumers, n = 1000000;
+    if (argc != 3 && argc != 4) {
+        report(1, "%s needs 2-3 arguments", argv[0]);
+        return false;
+    }
+
+    if (!get_int(argv[1], &producers) || !get_int(argv[2], &consumers) ||
+        producers < 1 || consumers < 1 ||
+        producers + consumers > MQ_MAX_THREADS) {
+        report(1, "Need 1 or more producers and consumers, at most %d in all",
+               MQ_MAX_THREADS);
+        return false;
+    }
+    if (argc == 4 && (!get_int(argv[3], &n) || n <= 0)) {
+        report(1, "Invalid number of elements '%s'", argv[3]);
+        return false;
+    }
+
+    return bench_mpmc(producers, consumers, n) && !error_check();
+}
+
+static bool do_cdq(int argc, char *argv[])
+{
+    int n = 1000000;
+    if (argc > 2 || (argc == 2 && (!get_int(argv[1], &n) || n <= 0))) {
+        report(1, "%s takes an optional positive number of operations",
+               argv[0]);
+        return false;
+    }
+
+    return bench_cdeque(n) && !error_check();
+}
+
+static bool do_forkjoin(int argc, char *argv[])
+{
+    int n = 1 << 24;
+    if (argc > 2 || (argc == 2 && (!get_int(argv[1], &n) || n <= 0))) {
+        report(1, "%s takes an optional positive range length", argv[0]);
+        return false;
+    }
+
+    return bench_forkjoin(n) && !error_check();
+}
+
+static bool do_spsc(int argc, char *argv[])
+{
+    int n = 1000000;
+    if (argc > 2 || (argc == 2 && (!get_int(argv[1], &n) || n <= 0))) {
+        report(1, "%s takes an optional positive number of messages", argv[0]);
+        return false;
+    }
+
+    return bench_spsc(n) && !error_check();
+}
+
+static bool do_shmq(int argc, char *argv[])
+{
+    int n = 1000000;
+    if (argc > 2 || (argc == 2 && (!get_int(argv[1], &n) || n <= 0))) {
+        report(1, "%s takes an optional positive number of strings", argv[0]);
+        return false;
+    }
+
+    return bench_shmq(n) && !error_check();
+}
+
+static bool do_save(int argc, char *argv[])
+{
+    if (argc != 2) {
+        report(1, "%s takes a file name", argv[0]);
+        return false;
+    }
+    if (!current || !current->q) {
+        report(3, "Warning: Calling save on null queue");
+        return false;
+    }
+    error_check();
+
+    if (!qfile_save(current->q, argv[1])) {
+        report(1, "ERROR: Could not save queue to '%s': %s", argv[1],
+               strerror(errno));
+        return false;
+    }
+    return !error_check();
+}
+
+static bool do_load(int argc, char *argv[])
+{
+    if (argc != 2) {
+        report(1, "%s takes a file name", argv[0]);
+        return false;
+    }
+    if (!current || !current->q) {
+        report(3, "Warning: Calling load on null queue");
+        return false;
+    }
+    error_check();
+
+    /* Like a failed insertion, a failed load leaves the queue as it was */
+    if (!qfile_load(current->q, argv[1])) {
+        int err = errno;
+        fail_count++;
+        if (fail_count < fail_limit) {
+            report(2, "Loading queue from '%s' failed: %s", argv[1],
+                   strerror(err));
+            q_show(3);
+            return !error_check();
+        }
+        report(1,
+               "ERROR: Could not load queue from '%s': %s (%d failures "
+               "total)",
+               argv[1], strerror(err), fail_count);
+        return false;
+    }
+    current->size = q_size(current->q);
+    bool ok = jlog_contents();
+    q_show(3);
+    return ok && !error_check();
+}
+
+static bool do_extsort(int argc, char *argv[])
+{
+    int n = 0;
+    if (argc > 2 || (argc == 2 && (!get_int(argv[1], &n) || n <= 0))) {
+        report(1, "%s takes an optional positive number of strings", argv[0]);
+        return false;
+    }
+    if (ext_budget <= 0) {
+        report(1, "ERROR: extbudget must be positive");
+        return false;
+    }
+
+    size_t budget = (size_t) ext_budget << 10;
+    if (argc == 2)
+        return bench_extsort(n, budget, descend) && !error_check();
+
+    if (!current || !current->q) {
+        report(3, "Warning: Calling extsort on null queue");
+        return !error_check();
+    }
+    error_check();
+
+    int cnt = q_size(current->q);
+    if (cnt > BIG_LIST_SIZE)
+        set_cautious_mode(false);
+    extsort_stats_t stats;
+    bool ok = extsort_queue(current->q, descend, budget, &stats);
+    set_cautious_mode(true);
+    if (!ok) {
+        report(1, "ERROR: External sort failed, queue left as it was");
+        return false;
+    }
+    ok = jlog(JOURNAL_SORT, descend, NULL);
+    report(2, "Spilled %lu runs in %lu merge passes, %lu bytes",
+           (unsigned long) stats.runs, (unsigned long) stats.passes,
+           (unsigned long) stats.spilled);
+
+    for (struct list_head *cur_l = q_step(current->q);
+         cur_l != current->q && --cnt > 0; cur_l = q_step(cur_l)) {
+        element_t *item = list_entry(cur_l, element_t, list);
+        element_t *next_item = list_entry(q_step(cur_l), element_t, list);
+        int cmp = strcmp(item->value, next_item->value);
+        if (descend ? cmp < 0 : cmp > 0) {
+            report(1, "ERROR: Not sorted in %s order",
+                   descend ? "descending" : "ascending");
+            ok = false;
+            break;
+        }
+    }
+
+    q_show(3);
+    return ok && !error_check();
+}
+
+static bool do_journal(int argc, char *argv[])
+{
+    int torn = 0;
+    bool crash = argc == 3 && !strcmp(argv[1], "crash");
+    if (argc > 3 || (crash && (!get_int(argv[2], &torn) || torn < 0)) ||
+        (argc == 3 && !crash && strcmp(argv[2], "new"))) {
+        report(1,
+               "%s takes an optional file name followed by 'new', 'off' or "
+               "'crash' followed by a number of bytes",
+               argv[0]);
+        return false;
+    }
+
+    if (argc == 1) {
+        if (!journal) {
+            report(1, "No queue is journaled");
+            return true;
+        }
+        const journal_stats_t *st = journal_stats(journal);
+        report(1,
+               "Journaled %lu records in %lu commits, %lu bytes, after "
+               "replaying %lu",
+               (unsigned long) st->records, (unsigned long) st->commits,
+               (unsigned long) st->bytes, (unsigned long) st->replayed);
+        return true;
+    }
+
+    if (!strcmp(argv[1], "off"))
+        return journal_detach(journal_q) && !error_check();
+
+    /* The pending records are lost but for the first torn bytes */
+    if (crash) {
+        if (!journal) {
+            report(1, "ERROR: No queue is journaled");
+            return false;
+        }
+        bool ok = journal_crash(journal, torn);
+        if (!ok)
+            report(1, "ERROR: Could not write journal: %s", strerror(errno));
+        journal = NULL;
+        journal_q = NULL;
+        return ok && !error_check();
+    }
+
+    if (!current || !current->q) {
+        report(3, "Warning: Calling journal on null queue");
+        return false;
+    }
+    if (journal) {
+        report(1, "ERROR: A queue is already journaled, turn it off first");
+        return false;
+    }
+    if (journal_batch < 0 || journal_delay < 0) {
+        report(1, "ERROR: jbatch and jdelay must not be negative");
+        return false;
+    }
+
+    /* Replaying on top of elements would not rebuild the journaled queue,
+     * but a new journal can start with them.
+     */
+    struct stat st;
+    bool fresh = argc == 3 || stat(argv[1], &st) || !st.st_size;
+    if (current->size && !fresh) {
+        report(1, "ERROR: Queue must be empty to replay a journal");
+        return false;
+    }
+    error_check();
+
+    if (argc == 3 && truncate(argv[1], 0) && errno != ENOENT) {
+        report(1, "ERROR: Could not empty journal '%s': %s", argv[1],
+               strerror(errno));
+        return false;
+    }
+
+    int cnt = q_size(current->q);
+    set_cautious_mode(false);
+    journal = journal_open(argv[1], current->q, journal_batch, journal_delay);
+    set_cautious_mode(true);
+    int err = errno;
+    current->size = q_size(current->q);
+    if (!journal) {
+        report(1, "ERROR: Could not open journal '%s': %s", argv[1],
+               strerror(err));
+        return false;
+    }
+    journal_q = current->q;
+
+    const journal_stats_t *jst = journal_stats(journal);
+    if (jst->dropped)
+        report(1, "Dropped %lu bytes of torn or corrupt records",
+               (unsigned long) jst->dropped);
+    report(2, "Replayed %lu records", (unsigned long) jst->replayed);
+
+    bool ok = true;
+    if (cnt)
+        ok = jlog_contents();
+    q_show(3);
+    return ok && !error_check();
+}
+
+/* Report a background save whose child is done, waiting for it if wait is
+ * set, and forget about it
+ */
+static bool bgsave_reap(bool wait)
+{
+    if (!bgsave || !snapshot_poll(bgsave, wait))
+        return true;
+
+    const snapshot_stats_t *st = snapshot_stats(bgsave);
+    bool ok = !st->error;
+    if (!ok) {
+        report(1, "ERROR: Background save failed: %s", strerror(st->error));
+    } else {
+        double t = st->save_ns / 1e9;
+        report(1, "Background save of %lu queues, %lu elements, %.1f MiB:",
+               (unsigned long) st->queues, (unsigned long) st->elements,
+               st->bytes / 1048576.0);
+        report(1, "  fork  %10.3f ms", st->fork_ns / 1e6);
+        report(1, "  save  %10.3f s  %12.0f elements/sec  %8.1f MiB/s", t,
+               t > 0 ? st->elements / t : 0,
+               t > 0 ? st->bytes / 1048576.0 / t : 0);
+        report(1, "  page faults %lu in the child, %lu in the parent until "
+                  "reaped",
+               (unsigned long) st->child_faults,
+               (unsigned long) st->parent_faults);
+    }
+    snapshot_free(bgsave);
+    bgsave = NULL;
+    return ok;
+}
+
+static bool do_bgsave(int argc, char *argv[])
+{
+    if (argc > 2) {
+        report(1, "%s takes an optional file name or 'wait'", argv[0]);
+        return false;
+    }
+
+    if (argc == 1 || !strcmp(argv[1], "wait")) {
+        if (!bgsave) {
+            report(1, "No background save in progress");
+            return true;
+        }
+        if (argc == 1 && !snapshot_poll(bgsave, false)) {
+            report(1, "Background save by pid %d in progress",
+                   (int) snapshot_pid(bgsave));
+            return true;
+        }
+        return bgsave_reap(true) && !error_check();
+    }
+
+    if (bgsave && !snapshot_poll(bgsave, false)) {
+        report(1, "ERROR: Background save by pid %d still in progress",
+               (int) snapshot_pid(bgsave));
+        return false;
+    }
+    bool ok = bgsave_reap(false);
+
+    bgsave = snapshot_start(&chain.head, argv[1]);
+    if (!bgsave) {
+        report(1, "ERROR: Could not start background save: %s",
+               strerror(errno));
+        return false;
+    }
+    report(2, "Background save started by pid %d, fork took %.3f ms",
+           (int) snapshot_pid(bgsave),
+           snapshot_stats(bgsave)->fork_ns / 1e6);
+    return ok && !error_check();
+}
+
 static bool is_circular()
 {
     struct list_head *cur = current->q->next;
@@ -1145,7 +2023,7 @@ static bool q_show(int vlevel)
     report_noreturn(vlevel, "l = [");
 
     struct list_head *ori = current->q;
-    struct list_head *cur = current->q->next;
+    struct list_head *cur = q_step(current->q);
 
     if (exception_setup(true)) {
         while (ok && ori != cur && cnt < current->size) {
@@ -1159,7 +2037,7 @@ static bool q_show(int vlevel)
                 }
             }
             cnt++;
-            cur = cur->next;
+            cur = q_step(cur);
             ok = ok && !error_check();
         }
     }
@@ -1258,10 +2136,11 @@ static void console_init()
                 "Insert string str at tail of queue n times. Generate random "
                 "string(s) if str equals RAND. (default: n == 1)",
                 "str [n]");
-    ADD_COMMAND(
-        rh,
-        "Remove from head of queue. Optionally compare to expected value str",
-        "[str]");
+    ADD_COMMAND(rh,
+                "Remove from head of queue. Optionally compare to expected "
+                "value str",
+                "[str]");
+    ADD_COMMAND(rhn, "Remove n elements from head of queue at once", "n");
     ADD_COMMAND(
         rt,
         "Remove from tail of queue. Optionally compare to expected value str",
@@ -1271,7 +2150,17 @@ static void console_init()
     ADD_COMMAND(size, "Compute queue size n times (default: n == 1)", "[n]");
     ADD_COMMAND(show, "Show queue contents", "");
     ADD_COMMAND(dm, "Delete middle node in queue", "");
-    ADD_COMMAND(dedup, "Delete all nodes that have duplicate string", "");
+    ADD_COMMAND(index,
+                "Maintain a positional index over the queue (default: 1)",
+                "[0|1]");
+    ADD_COMMAND(lazyrev, "Make reverse flip the queue in O(1) (default: 1)",
+                "[0|1]");
+    ADD_COMMAND(at, "Show the element at position i of the queue", "i [str]");
+    ADD_COMMAND(dat, "Delete the element at position i of the queue", "i");
+    ADD_COMMAND(dedup,
+                "Delete all nodes that have duplicate string, in any order "
+                "with 'all', keeping the first occurrence with 'first'",
+                "[all|first]");
     ADD_COMMAND(merge, "Merge all the queues into one sorted queue", "");
     ADD_COMMAND(swap, "Swap every two adjacent nodes in queue", "");
     ADD_COMMAND(ascend,
@@ -1289,6 +2178,55 @@ static void console_init()
         "Sort queue in ascending/descening order provided by linux kernel", "");
     ADD_COMMAND(shuffle, "Do the Fisher–Yates Shuffle algorithm", "");
     ADD_COMMAND(ttt, "Play the game Tic-tac-toe", "");
+    ADD_COMMAND(mpmc,
+                "Stream n elements through a lock-free queue from P producer "
+                "to C consumer threads, reporting ops/sec and latency "
+                "(default: n == 1000000)",
+                "P C [n]");
+    ADD_COMMAND(cdq,
+                "Compare one lock with a lock per end of a concurrent deque "
+                "under 1 to 32 threads, doing n operations per run "
+                "(default: n == 1000000)",
+                "[n]");
+    ADD_COMMAND(forkjoin,
+                "Run a fork-join sum over n numbers on work-stealing deques "
+                "with 1 to 16 threads, reporting throughput and steals "
+                "(default: n == 16777216)",
+                "[n]");
+    ADD_COMMAND(spsc,
+                "Stream n RAND strings from one producer thread to one "
+                "consumer through an SPSC channel, reporting msgs/sec and "
+                "bytes/sec per batch size (default: n == 1000000)",
+                "[n]");
+    ADD_COMMAND(shmq,
+                "Hand n RAND strings to another process through a "
+                "shared-memory queue and through a pipe, reporting msgs/sec "
+                "and bytes/sec (default: n == 1000000)",
+                "[n]");
+    ADD_COMMAND(extsort,
+                "Sort queue with an external merge sort spilling runs to "
+                "disk, or stream n generated RAND strings through it",
+                "[n]");
+    ADD_COMMAND(save, "Write queue to a file in the binary queue format",
+                "file");
+    ADD_COMMAND(load,
+                "Append the elements of a saved file at tail of queue, "
+                "mapping their strings from the file without copying",
+                "file");
+    ADD_COMMAND(bgsave,
+                "Write every queue to file.<id> in a forked child while "
+                "commands go on, or wait for it and report",
+                "[file|wait]");
+    ADD_COMMAND(journal,
+                "Log changes of queue to a journal file, replaying it first "
+                "unless new, or stop, or stop as a crash tearing the last "
+                "records after n bytes would",
+                "[file [new]|off|crash n]");
+    ADD_COMMAND(bench,
+                "Measure throughput and memory of queue backend with n "
+                "elements, or 'sort'/'merge' to compare the serial and "
+                "parallel sort/merge (default: n == 100000)",
+                "backend [n]");
     add_param("ai_vs_ai", &ai_vs_ai, "Enable ttt of AI vs AI", NULL);
     add_param("length", &string_length, "Maximum length of displayed string",
               NULL);
@@ -1298,6 +2236,35 @@ static void console_init()
               "Number of times allow queue operations to return false", NULL);
     add_param("descend", &descend,
               "Sort and merge queue in ascending/descending order", NULL);
+    add_param("sortalgo", &sort_algo,
+              "Algorithm used by sort: 0 for merge sort, 1 for MSD radix sort",
+              NULL);
+    add_param("extbudget", &ext_budget,
+              "Memory budget of extsort in KiB", NULL);
+    add_param("jbatch", &journal_batch,
+              "Records committed by the journal at once, 0 for no limit",
+              journal_commit_changed);
+    add_param("jdelay", &journal_delay,
+              "Microseconds a journal record may wait for commit, 0 for no "
+              "limit",
+              journal_commit_changed);
+    add_param("threads", &sort_threads,
+              "Number of threads used by the merge sort of sort and by merge",
+              NULL);
+    add_param("debug", &debug_mode,
+              "Verify cached queue size against a walk of the list", NULL);
+    add_param("intern", &intern_mode,
+              "Share one reference-counted copy of each distinct string", NULL);
+    add_param("ring", &sim_ring,
+              "Run simulation against the ring-buffer deque instead of queue",
+              NULL);
+    add_param("pool", &pool_mode,
+              "Pool small blocks of the harness instead of freeing them, "
+              "hiding memory errors in them from sanitizers",
+              pool_mode_changed);
+    add_param("validate", &validate,
+              "Check each inserted element, instead of inserting in bulk",
+              NULL);
 }
 
 /* Signal handlers */
@@ -1329,10 +2296,12 @@ static void q_init()
 
 static bool q_quit(int argc, char *argv[])
 {
+    bgsave_reap(true);
     report(3, "Freeing queue");
     if (current && current->size > BIG_LIST_SIZE)
         set_cautious_mode(false);
 
+    journal_detach(journal_q);
     if (exception_setup(true)) {
         struct list_head *cur = chain.head.next;
         while (chain.size > 0) {
@@ -1491,6 +2460,7 @@ int main(int argc, char *argv[])
         set_logfile(logfile_name);
 
     add_quit_helper(q_quit);
+    set_idle_helper(journal_idle);
 
     bool ok = true;
     ok = ok && run_console(infile_name);
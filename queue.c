@@ -2,7 +2,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "hlist.h"
+#include "intern.h"
+#include "qfile.h"
 #include "queue.h"
+#include "skiplist.h"
 
 /* Notice: sometimes, Cppcheck would find the potential NULL pointer bugs,
  * but some of them cannot occur. You can suppress them by adding the
@@ -10,18 +14,87 @@
  *   cppcheck-suppress nullPointer
  */
 
+/* Get the queue_head_t which embeds the list head handed out by q_new() */
+static inline queue_head_t *q_head(struct list_head *head)
+{
+    return list_entry(head, queue_head_t, head);
+}
+
+/* Mark the index of a queue stale after its elements were relinked */
+static inline void q_relinked(struct list_head *head)
+{
+    if (q_head(head)->index)
+        sl_invalidate(q_head(head)->index);
+}
+
+/* Reverse the nodes of any list, whether a queue or not */
+static void list_reverse(struct list_head *head)
+{
+    struct list_head *node = NULL, *safe = NULL;
+    list_for_each_safe (node, safe, head) {
+        list_move(node, head);
+    }
+}
+
+/* Allocate an element holding a copy of @s in its inline storage, or a
+ * reference to the shared copy in interning mode.
+ */
+static element_t *element_new(const char *s)
+{
+    if (intern_mode) {
+        element_t *e = malloc(sizeof(element_t) + 1);
+        if (!e)
+            return NULL;
+
+        e->data[0] = ELEMENT_INTERNED;
+        e->value = intern_get(s);
+        if (!e->value) {
+            free(e);
+            return NULL;
+        }
+        return e;
+    }
+
+    size_t len = strlen(s) + 1;
+    element_t *e = malloc(sizeof(element_t) + len);
+    if (!e)
+        return NULL;
+
+    e->value = memcpy(e->data, s, len);
+    return e;
+}
+
+/* Release the element */
+void q_release_element(element_t *e)
+{
+    if (e->value != e->data) {
+        if (e->data[0] == ELEMENT_MAPPED)
+            qfile_put(e->value);
+        else
+            intern_put(e->value);
+    }
+    free(e);
+}
+
+/* Compare two values, telling shared interned strings apart by identity */
+static inline int value_cmp(const char *a, const char *b)
+{
+    return a == b ? 0 : strcmp(a, b);
+}
 
 /* Create an empty queue */
 struct list_head *q_new()
 {
-    struct list_head *q_head = malloc(sizeof(*q_head));
-    if (!q_head) {
-        free(q_head);
+    queue_head_t *q = malloc(sizeof(*q));
+    if (!q)
         return NULL;
-    }
 
-    INIT_LIST_HEAD(q_head);
-    return q_head;
+    INIT_LIST_HEAD(&q->head);
+    q->size = 0;
+    q->index = NULL;
+    q->lazy_reverse = false;
+    q->reversed = false;
+    return &q->head;
 }
 
 /* Free all storage used by queue */
@@ -33,57 +106,122 @@ void q_free(struct list_head *l)
     element_t *entry = NULL, *safe = NULL;
     list_for_each_entry_safe (entry, safe, l, list)
         q_release_element(entry);
-    free(l);
+    sl_free(q_head(l)->index);
+    free(q_head(l));
     return;
 }
 
-/* Insert an element at head of queue */
-bool q_insert_head(struct list_head *head, char *s)
+/* Link a new element at the front of the list if front, else at its back */
+static bool q_insert(struct list_head *head, char *s, bool front)
 {
     if (!head)
         return false;
 
-    element_t *new = malloc(sizeof(element_t));
+    element_t *new = element_new(s);
     if (!new)
         return false;
 
-    new->value = strdup(s);
-    if (!new->value) {
-        free(new);
-        return false;
+    queue_head_t *q = q_head(head);
+    if (front) {
+        list_add(&new->list, head);
+        if (q->index)
+            sl_insert_head(q->index, &new->list);
+    } else {
+        list_add_tail(&new->list, head);
+        if (q->index)
+            sl_insert_tail(q->index, &new->list);
     }
-    list_add(&new->list, head);
+    q->size++;
     return true;
 }
 
+/* Insert an element at head of queue */
+bool q_insert_head(struct list_head *head, char *s)
+{
+    return q_insert(head, s, !head || !q_head(head)->reversed);
+}
+
 /* Insert an element at tail of queue */
 bool q_insert_tail(struct list_head *head, char *s)
 {
-    if (!head)
-        return false;
+    return q_insert(head, s, head && q_head(head)->reversed);
+}
 
-    element_t *new = malloc(sizeof(element_t));
-    if (!new)
+/* Build the elements for @s on @list, in the order q_insert_head() or
+ * q_insert_tail() would link them, releasing all of them on failure. Each
+ * element remains an allocation of its own, which the harness tracks and
+ * checks like any other; they are not carved out of a shared chunk.
+ */
+static bool build_chain(struct list_head *list, char **s, int n, bool at_head)
+{
+    for (int i = 0; i < n; i++) {
+        element_t *new = element_new(s[i]);
+        if (!new) {
+            element_t *entry = NULL, *safe = NULL;
+            list_for_each_entry_safe (entry, safe, list, list)
+                q_release_element(entry);
+            INIT_LIST_HEAD(list);
+            return false;
+        }
+
+        if (at_head)
+            list_add(&new->list, list);
+        else
+            list_add_tail(&new->list, list);
+    }
+    return true;
+}
+
+/* Link a batch of new elements at the front of the list if front, else at
+ * its back, in the order single insertions would leave them.
+ */
+static bool q_insert_bulk(struct list_head *head, char **s, int n, bool front)
+{
+    if (!head || !s || n < 0)
         return false;
 
-    new->value = strdup(s);
-    if (!new->value) {
-        free(new);
+    LIST_HEAD(chain);
+    if (!build_chain(&chain, s, n, front))
         return false;
-    }
-    list_add_tail(&new->list, head);
+
+    if (front)
+        list_splice(&chain, head);
+    else
+        list_splice_tail(&chain, head);
+    q_head(head)->size += n;
+    q_relinked(head);
     return true;
 }
 
-/* Remove an element from head of queue */
-element_t *q_remove_head(struct list_head *head, char *sp, size_t bufsize)
+/* Insert a batch of elements at head of queue */
+bool q_insert_head_bulk(struct list_head *head, char **s, int n)
+{
+    return q_insert_bulk(head, s, n, !head || !q_head(head)->reversed);
+}
+
+/* Insert a batch of elements at tail of queue */
+bool q_insert_tail_bulk(struct list_head *head, char **s, int n)
+{
+    return q_insert_bulk(head, s, n, head && q_head(head)->reversed);
+}
+
+/* Unlink the element at the front of the list if front, else at its back */
+static element_t *q_remove(struct list_head *head,
+                           char *sp,
+                           size_t bufsize,
+                           bool front)
 {
     if (!head || list_empty(head))
         return NULL;
 
-    element_t *rmv_element = list_first_entry(head, element_t, list);
-    if (!rmv_element) {
-        return NULL;
+    queue_head_t *q = q_head(head);
+    element_t *rmv_element = front ? list_first_entry(head, element_t, list)
+                                   : list_last_entry(head, element_t, list);
+    if (q->index) {
+        if (front)
+            sl_remove_head(q->index, &rmv_element->list);
+        else
+            sl_remove_tail(q->index, &rmv_element->list);
     }
 
     if (sp != NULL) {
@@ -92,67 +230,198 @@ element_t *q_remove_head(struct list_head *head, char *sp, size_t bufsize)
     }
 
     list_del(&rmv_element->list);
+    q->size--;
 
     return rmv_element;
 }
 
+/* Remove an element from head of queue */
+element_t *q_remove_head(struct list_head *head, char *sp, size_t bufsize)
+{
+    return q_remove(head, sp, bufsize, !head || !q_head(head)->reversed);
+}
+
 /* Remove an element from tail of queue */
 element_t *q_remove_tail(struct list_head *head, char *sp, size_t bufsize)
 {
-    if (!head || list_empty(head))
-        return NULL;
+    return q_remove(head, sp, bufsize, head && q_head(head)->reversed);
+}
 
-    element_t *rmv_element = list_last_entry(head, element_t, list);
-    if (!rmv_element) {
-        return NULL;
+/* Remove a run of elements from head of queue */
+int q_remove_head_n(struct list_head *head, int n, struct list_head *list)
+{
+    if (!head || !list || n <= 0 || list_empty(head))
+        return 0;
+
+    q_normalize(head);
+    q_relinked(head);
+    int size = q_size(head);
+    if (n >= size) {
+        list_splice_tail_init(head, list);
+        q_head(head)->size = 0;
+        return size;
     }
 
-    if (sp != NULL) {
-        strncpy(sp, rmv_element->value, bufsize);
-        sp[bufsize - 1] = '\0';
+    /* Find the last element to remove, walking from the closer end */
+    struct list_head *last;
+    if (n <= size / 2) {
+        last = head->next;
+        for (int i = 1; i < n; i++)
+            last = last->next;
+    } else {
+        last = head->prev;
+        for (int i = size; i > n; i--)
+            last = last->prev;
     }
 
-    list_del(&rmv_element->list);
+    LIST_HEAD(cut);
+    list_cut_position(&cut, head, last);
+    list_splice_tail(&cut, list);
+    q_head(head)->size -= n;
+    return n;
+}
 
-    return rmv_element;
+/* Move a list of elements to the tail of queue */
+bool q_splice_tail(struct list_head *head, struct list_head *list, int n)
+{
+    if (!head || !list)
+        return false;
+
+    queue_head_t *q = q_head(head);
+    if (q->reversed) {
+        list_reverse(list);
+        list_splice_init(list, head);
+    } else {
+        list_splice_tail_init(list, head);
+    }
+    q->size += n;
+    q_relinked(head);
+    return true;
 }
 
 /* Return number of elements in queue */
 int q_size(struct list_head *head)
 {
-    if (!head || list_empty(head))
+    if (!head)
         return 0;
 
-    int cnt = 0;
-    struct list_head *cur;
-    list_for_each (cur, head) {
-        cnt++;
+    return q_head(head)->size;
+}
+
+/* Enable or disable the positional index of a queue */
+bool q_set_indexed(struct list_head *head, bool indexed)
+{
+    if (!head)
+        return false;
+
+    queue_head_t *q = q_head(head);
+    if (!indexed) {
+        sl_free(q->index);
+        q->index = NULL;
+    } else if (!q->index) {
+        q->index = sl_new(head);
     }
-    return cnt;
+    return !indexed || q->index;
 }
 
-/* Delete the middle node in queue */
-bool q_delete_mid(struct list_head *head)
+/* Tell a queue its elements were relinked */
+void q_reordered(struct list_head *head)
 {
-    if (!head || list_empty(head))
+    if (head)
+        q_relinked(head);
+}
+
+/* Enable or disable lazy reversal of a queue */
+bool q_set_lazy_reverse(struct list_head *head, bool lazy)
+{
+    if (!head)
         return false;
 
-    int leng = q_size(head);
-    int cnt = -1;
+    if (!lazy)
+        q_normalize(head);
+    q_head(head)->lazy_reverse = lazy;
+    return true;
+}
 
-    element_t *entry = NULL, *safe = NULL;
-    list_for_each_entry_safe (entry, safe, head, list) {
-        cnt++;
-        if (cnt == (leng / 2)) {
-            list_del(&entry->list);
-            free(entry->value);
-            free(entry);
-            break;
-        }
+/* Whether a queue is linked from tail to head */
+bool q_reversed(struct list_head *head)
+{
+    return head && q_head(head)->reversed;
+}
+
+/* Apply a pending lazy reversal */
+void q_normalize(struct list_head *head)
+{
+    if (!q_reversed(head))
+        return;
+
+    list_reverse(head);
+    q_head(head)->reversed = false;
+    q_relinked(head);
+}
+
+/* Find the node at position i from the front of the list, walking from the
+ * closer end without index
+ */
+static struct list_head *q_node_at(struct list_head *head, int i)
+{
+    queue_head_t *q = q_head(head);
+    if (q->index)
+        return sl_at(q->index, q->size, i);
+
+    struct list_head *node;
+    if (i < q->size / 2) {
+        for (node = head->next; i > 0; i--)
+            node = node->next;
+    } else {
+        for (node = head->prev, i = q->size - 1 - i; i > 0; i--)
+            node = node->prev;
+    }
+    return node;
+}
+
+/* Get the element at a position of the queue */
+element_t *q_at(struct list_head *head, int i)
+{
+    if (!head || i < 0 || i >= q_size(head))
+        return NULL;
+
+    if (q_reversed(head))
+        i = q_size(head) - 1 - i;
+    return list_entry(q_node_at(head, i), element_t, list);
+}
+
+/* Delete the element at a position of the queue */
+bool q_delete_at(struct list_head *head, int i)
+{
+    if (!head || i < 0 || i >= q_size(head))
+        return false;
+
+    queue_head_t *q = q_head(head);
+    if (q->reversed)
+        i = q->size - 1 - i;
+
+    struct list_head *node;
+    if (q->index) {
+        node = sl_remove_at(q->index, q->size, i);
+    } else {
+        node = q_node_at(head, i);
+        list_del(node);
     }
+    q_release_element(list_entry(node, element_t, list));
+    q->size--;
     return true;
 }
 
+/* Delete the middle node in queue */
+bool q_delete_mid(struct list_head *head)
+{
+    if (!head || list_empty(head))
+        return false;
+
+    return q_delete_at(head, q_size(head) / 2);
+}
+
 /* Delete all nodes that have duplicate string */
 bool q_delete_dup(struct list_head *head)
 {
@@ -162,27 +431,114 @@ bool q_delete_dup(struct list_head *head)
     element_t *entry = NULL, *safe = NULL;
     bool dup = false;
 
+    q_relinked(head);
     list_for_each_entry_safe (entry, safe, head, list) {
         if (entry->list.next != head &&
-            strcmp(entry->value, safe->value) == 0) {
+            value_cmp(entry->value, safe->value) == 0) {
             list_del(&entry->list);
             q_release_element(entry);
+            q_head(head)->size--;
             dup = true;
         } else if (dup) {
             list_del(&entry->list);
             q_release_element(entry);
+            q_head(head)->size--;
             dup = false;
         }
     }
     return true;
 }
 
+/**
+ * dedup_entry_t - An element seen by q_delete_dup_unsorted()
+ * @node: node in the bucket of the string, for first occurrences only
+ * @elem: the element
+ * @first: the entry of the first occurrence of the string
+ * @dup: whether the string occurs more than once, valid on first occurrences
+ */
+typedef struct dedup_entry {
+    struct hlist_node node;
+    element_t *elem;
+    struct dedup_entry *first;
+    bool dup;
+} dedup_entry_t;
+
+/* Delete duplicate strings from a queue in any order */
+bool q_delete_dup_unsorted(struct list_head *head, bool keep_first)
+{
+    if (!head)
+        return false;
+
+    int n = q_size(head);
+    if (n < 2)
+        return true;
+
+    /* Which occurrence comes first depends on the direction */
+    if (keep_first)
+        q_normalize(head);
+
+    /* One entry per element, and at most one element per bucket on average */
+    size_t nr_buckets = 1;
+    while (nr_buckets < (size_t) n)
+        nr_buckets <<= 1;
+    struct hlist_head *buckets = malloc(sizeof(*buckets) * nr_buckets);
+    dedup_entry_t *entries = malloc(sizeof(*entries) * n);
+    if (!buckets || !entries) {
+        free(buckets);
+        free(entries);
+        return false;
+    }
+    for (size_t i = 0; i < nr_buckets; i++)
+        INIT_HLIST_HEAD(&buckets[i]);
+
+    dedup_entry_t *e = entries;
+    element_t *entry = NULL, *safe = NULL;
+    list_for_each_entry (entry, head, list) {
+        struct hlist_head *bucket =
+            &buckets[intern_hash(entry->value) & (nr_buckets - 1)];
+        dedup_entry_t *seen = NULL;
+
+        e->elem = entry;
+        e->first = e;
+        e->dup = false;
+        hlist_for_each_entry (seen, bucket, node) {
+            if (!value_cmp(seen->elem->value, entry->value)) {
+                seen->dup = true;
+                e->first = seen;
+                break;
+            }
+        }
+        if (e->first == e)
+            hlist_add_head(&e->node, bucket);
+        e++;
+    }
+
+    e = entries;
+    list_for_each_entry_safe (entry, safe, head, list) {
+        if (e->first->dup && (e->first != e || !keep_first)) {
+            list_del(&entry->list);
+            q_release_element(entry);
+            q_head(head)->size--;
+        }
+        e++;
+    }
+
+    free(buckets);
+    free(entries);
+    q_relinked(head);
+    return true;
+}
+
 /* Swap every two adjacent nodes */
 void q_swap(struct list_head *head)
 {
     if (!head || list_empty(head))
         return;
 
+    /* An even number of elements pairs up the same way from either end */
+    if (q_size(head) & 1)
+        q_normalize(head);
+    q_relinked(head);
     struct list_head *pre, *cur;
     for (pre = head->next, cur = pre->next; pre != head && cur != head;
          pre = pre->next, cur = pre->next) {
@@ -196,18 +552,23 @@ void q_reverse(struct list_head *head)
     if (!head || list_empty(head))
         return;
 
-    struct list_head *node = NULL, *safe = NULL;
-    list_for_each_safe (node, safe, head) {
-        list_move(node, head);
+    queue_head_t *q = q_head(head);
+    if (q->lazy_reverse) {
+        q->reversed = !q->reversed;
+        return;
     }
+
+    list_reverse(head);
+    q_relinked(head);
 }
 
 /* Reverse the nodes of the list k at a time */
 void q_reverseK(struct list_head *head, int k)
 {
-    if (!head || list_empty(head) || k == 0)
+    if (!head || list_empty(head) || k <= 0)
         return;
 
+    q_normalize(head);
     struct list_head *cur_tail = head->next;
     int rev_times = q_size(head) / k;
 
@@ -218,10 +579,88 @@ void q_reverseK(struct list_head *head, int k)
         for (int j = 0; j < k; ++j)
             cur_tail = cur_tail->next;
         list_cut_position(&tmp, head, cur_tail->prev);
-        q_reverse(&tmp);
+        list_reverse(&tmp);
         list_splice_tail_init(&tmp, &result);
     }
     list_splice_init(&result, head);
+    q_relinked(head);
+}
+
+/* After this many consecutive wins of one side, merge2list() gallops */
+#define MIN_GALLOP 7
+
+/* Compare two nodes in the order the queue is being sorted to */
+static inline int elem_cmp(struct list_head *a,
+                           struct list_head *b,
+                           bool descend)
+{
+    int cmp = value_cmp(list_entry(a, element_t, list)->value,
+                        list_entry(b, element_t, list)->value);
+    return descend ? -cmp : cmp;
+}
+
+/* Whether node goes before pivot when merging; nodes of the left list go
+ * first on ties to keep the sort stable.
+ */
+static inline bool goes_before(struct list_head *node,
+                               struct list_head *pivot,
+                               bool left,
+                               bool descend)
+{
+    return left ? elem_cmp(node, pivot, descend) <= 0
+                : elem_cmp(pivot, node, descend) > 0;
+}
+
+/* Find the last node of list, starting from first, which goes before pivot.
+ * first itself is known to. Probes at exponentially growing distances and
+ * then bisects, so only O(log k) comparisons are spent on a run of k nodes.
+ */
+static struct list_head *gallop(struct list_head *list,
+                                struct list_head *first,
+                                struct list_head *pivot,
+                                bool left,
+                                bool descend)
+{
+    struct list_head *lo = first, *probe = first;
+    int step = 1, dist;
+
+    for (;;) {
+        for (dist = 0; dist < step && probe->next != list; dist++)
+            probe = probe->next;
+        if (!dist)
+            return lo;
+        if (!goes_before(probe, pivot, left, descend))
+            break;
+        lo = probe;
+        if (dist < step)
+            return lo;
+        step <<= 1;
+    }
+
+    /* lo goes before pivot, probe does not, and dist - 1 nodes lie between */
+    for (int len = dist - 1; len > 0;) {
+        int half = (len + 1) / 2;
+        struct list_head *mid = lo;
+        for (int i = 0; i < half; i++)
+            mid = mid->next;
+        if (goes_before(mid, pivot, left, descend)) {
+            lo = mid;
+            len -= half;
+        } else {
+            len = half - 1;
+        }
+    }
+    return lo;
+}
+
+/* Move the nodes from the first one of list up to last to the tail of head */
+static inline void move_run_tail(struct list_head *list,
+                                 struct list_head *last,
+                                 struct list_head *head)
+{
+    LIST_HEAD(run);
+    list_cut_position(&run, list, last);
+    list_splice_tail(&run, head);
 }
 
 void merge2list(struct list_head *left_head,
@@ -229,20 +668,43 @@ void merge2list(struct list_head *left_head,
                 struct list_head *head,
                 bool descend)
 {
-    while (!list_empty(left_head) && !list_empty(right_head)) {
-        element_t *left_entry = list_entry(left_head->next, element_t, list);
-        element_t *right_entry = list_entry(right_head->next, element_t, list);
+    /* Inputs which do not interleave are simply concatenated */
+    if (list_empty(left_head) || list_empty(right_head) ||
+        elem_cmp(left_head->prev, right_head->next, descend) <= 0) {
+        list_splice_tail_init(left_head, head);
+        list_splice_tail_init(right_head, head);
+        return;
+    }
+    if (elem_cmp(left_head->next, right_head->prev, descend) > 0) {
+        list_splice_tail_init(right_head, head);
+        list_splice_tail_init(left_head, head);
+        return;
+    }
 
-        if (!descend) {
-            if (strcmp(left_entry->value, right_entry->value) <= 0)
+    int left_wins = 0, right_wins = 0;
+    while (!list_empty(left_head) && !list_empty(right_head)) {
+        if (elem_cmp(left_head->next, right_head->next, descend) <= 0) {
+            right_wins = 0;
+            if (++left_wins < MIN_GALLOP) {
                 list_move_tail(left_head->next, head);
-            else
-                list_move_tail(right_head->next, head);
+                continue;
+            }
+            move_run_tail(left_head,
+                          gallop(left_head, left_head->next, right_head->next,
+                                 true, descend),
+                          head);
+            left_wins = 0;
         } else {
-            if (strcmp(left_entry->value, right_entry->value) >= 0)
-                list_move_tail(left_head->next, head);
-            else
+            left_wins = 0;
+            if (++right_wins < MIN_GALLOP) {
                 list_move_tail(right_head->next, head);
+                continue;
+            }
+            move_run_tail(right_head,
+                          gallop(right_head, right_head->next, left_head->next,
+                                 false, descend),
+                          head);
+            right_wins = 0;
         }
     }
 
@@ -252,77 +714,199 @@ void merge2list(struct list_head *left_head,
         list_splice_tail_init(left_head, head);
 }
 
-/* Sort elements of queue in ascending/descending order */
-void q_sort(struct list_head *head, bool descend)
+/* Cut the natural run at the front of head onto run. A strictly descending
+ * run is reversed in place; keeping it strict preserves stability.
+ */
+static void cut_run(struct list_head *head, struct list_head *run, bool descend)
+{
+    struct list_head *last = head->next;
+
+    if (last->next != head && elem_cmp(last, last->next, descend) > 0) {
+        while (last->next != head && elem_cmp(last, last->next, descend) > 0)
+            last = last->next;
+        list_cut_position(run, head, last);
+
+        struct list_head *node = NULL, *safe = NULL;
+        list_for_each_safe (node, safe, run)
+            list_move(node, run);
+        return;
+    }
+
+    while (last->next != head && elem_cmp(last, last->next, descend) <= 0)
+        last = last->next;
+    list_cut_position(run, head, last);
+}
+
+/* Sort a list of element_t */
+void sort_list(struct list_head *head, bool descend)
 {
     if (!head || list_empty(head) || list_is_singular(head))
         return;
 
-    struct list_head *slow = head, *fast = head;
+    /* The natural runs of the input are merged like a binary counter:
+     * pending[k] is either empty or holds 2^k runs merged together, so
+     * every node takes part in O(log r) merges for r runs. Sorted and
+     * reverse-sorted input is a single run and costs one pass.
+     */
+    struct list_head pending[64];
+    int levels = 0;
+
+    while (!list_empty(head)) {
+        LIST_HEAD(run);
+        cut_run(head, &run, descend);
+
+        int k;
+        for (k = 0; k < levels && !list_empty(&pending[k]); k++) {
+            LIST_HEAD(merged);
+            merge2list(&pending[k], &run, &merged, descend);
+            list_splice(&merged, &run);
+        }
+        if (k == levels)
+            INIT_LIST_HEAD(&pending[levels++]);
+        list_splice(&run, &pending[k]);
+    }
 
-    do {
-        fast = fast->next->next;
-        slow = slow->next;
-    } while (!(fast == head || fast->next == head));
+    /* Lower levels hold later runs, so they go to the right */
+    for (int k = 0; k < levels; k++) {
+        LIST_HEAD(merged);
+        merge2list(&pending[k], head, &merged, descend);
+        list_splice(&merged, head);
+    }
+}
 
-    LIST_HEAD(left_head);
-    LIST_HEAD(right_head);
-    list_splice_tail_init(head, &right_head);
-    list_cut_position(&left_head, &right_head, slow);
+/* Sort elements of queue in ascending/descending order */
+void q_sort(struct list_head *head, bool descend)
+{
+    if (!head)
+        return;
 
-    q_sort(&left_head, descend);
-    q_sort(&right_head, descend);
-    merge2list(&left_head, &right_head, head, descend);
+    /* Stale before the first node moves, in case the sort is cut short */
+    q_relinked(head);
+    /* A lazily reversed queue is linked in the opposite order */
+    sort_list(head, descend != q_reversed(head));
 }
 
-/* Remove every node which has a node with a strictly less value anywhere to
- * the right side of it */
-int q_ascend(struct list_head *head)
+/* Walk from the tail to the head of the queue, in whichever direction it
+ * is linked, and remove every node not strictly before the last one kept in
+ * the order given by ascend.
+ */
+static int q_monotone(struct list_head *head, bool ascend)
 {
     if (!head || list_empty(head)) {
         return 0;
     }
 
+    q_relinked(head);
+    bool rev = q_reversed(head);
+    struct list_head *last = rev ? head->next : head->prev;
     struct list_head *cur, *safe;
-    char *s = list_entry(head->prev, element_t, list)->value;
-    for (cur = (head)->prev, safe = cur->prev; cur != (head);
-         cur = safe, safe = cur->prev) {
+    char *s = list_entry(last, element_t, list)->value;
+    for (cur = rev ? last->next : last->prev; cur != head; cur = safe) {
         element_t *tmp = list_entry(cur, element_t, list);
-        if (cur != head->prev) {
-            if (strcmp(s, tmp->value) > 0) {
-                s = tmp->value;
-            } else {
-                list_del(&tmp->list);
-                q_release_element(tmp);
-            }
+        int cmp = strcmp(s, tmp->value);
+        safe = rev ? cur->next : cur->prev;
+        if (ascend ? cmp > 0 : cmp < 0) {
+            s = tmp->value;
+        } else {
+            list_del(&tmp->list);
+            q_release_element(tmp);
+            q_head(head)->size--;
         }
     }
     return q_size(head);
 }
 
+/* Remove every node which has a node with a strictly less value anywhere to
+ * the right side of it */
+int q_ascend(struct list_head *head)
+{
+    return q_monotone(head, true);
+}
+
 /* Remove every node which has a node with a strictly greater value anywhere to
  * the right side of it */
 int q_descend(struct list_head *head)
 {
-    if (!head || list_empty(head)) {
-        return 0;
+    return q_monotone(head, false);
+}
+
+/* Most queues merged by a single heap in q_merge() */
+#define MERGE_FANOUT 256
+
+/**
+ * merge_src_t - A queue taking part in a k-way merge
+ * @ctx: the queue context
+ * @order: position of the queue in the chain, breaking ties
+ */
+typedef struct {
+    queue_contex_t *ctx;
+    int order;
+} merge_src_t;
+
+/* Whether the head of a goes before the head of b in the merged queue */
+static inline bool src_before(const merge_src_t *a,
+                              const merge_src_t *b,
+                              bool descend)
+{
+    int cmp = elem_cmp(a->ctx->q->next, b->ctx->q->next, descend);
+    return cmp < 0 || (!cmp && a->order < b->order);
+}
+
+static void sift_down(merge_src_t *heap, int n, int i, bool descend)
+{
+    merge_src_t src = heap[i];
+
+    for (int child; (child = 2 * i + 1) < n; i = child) {
+        if (child + 1 < n &&
+            src_before(&heap[child + 1], &heap[child], descend))
+            child++;
+        if (!src_before(&heap[child], &src, descend))
+            break;
+        heap[i] = heap[child];
     }
+    heap[i] = src;
+}
 
-    struct list_head *cur, *safe;
-    char *s = list_entry(head->prev, element_t, list)->value;
-    for (cur = (head)->prev, safe = cur->prev; cur != (head);
-         cur = safe, safe = cur->prev) {
-        element_t *tmp = list_entry(cur, element_t, list);
-        if (cur != head->prev) {
-            if (strcmp(s, tmp->value) < 0) {
-                s = tmp->value;
-            } else {
-                list_del(&tmp->list);
-                q_release_element(tmp);
-            }
-        }
+/* Merge the non-empty queues of heap into the queue of dst. The queue at
+ * the top gives up its whole run which goes before the runner-up, found by
+ * galloping, so shards which do not interleave move in long pieces.
+ */
+static void merge_heap(merge_src_t *heap,
+                       int n,
+                       queue_contex_t *dst,
+                       bool descend)
+{
+    LIST_HEAD(merged);
+    int size = 0;
+
+    for (int i = 0; i < n; i++) {
+        size += q_head(heap[i].ctx->q)->size;
+        q_head(heap[i].ctx->q)->size = 0;
+        q_relinked(heap[i].ctx->q);
     }
-    return q_size(head);
+    for (int i = n / 2 - 1; i >= 0; i--)
+        sift_down(heap, n, i, descend);
+
+    while (n > 1) {
+        struct list_head *q = heap[0].ctx->q;
+        const merge_src_t *next = &heap[1];
+        if (n > 2 && src_before(&heap[2], &heap[1], descend))
+            next = &heap[2];
+
+        move_run_tail(q,
+                      gallop(q, q->next, next->ctx->q->next,
+                             heap[0].order < next->order, descend),
+                      &merged);
+        if (list_empty(q))
+            heap[0] = heap[--n];
+        sift_down(heap, n, 0, descend);
+    }
+    if (n)
+        list_splice_tail_init(heap[0].ctx->q, &merged);
+
+    list_splice(&merged, dst->q);
+    q_head(dst->q)->size = size;
+    q_relinked(dst->q);
 }
 
 /* Merge all the queues into one sorted queue, which is in ascending/descending
@@ -332,28 +916,40 @@ int q_merge(struct list_head *head, bool descend)
     if (!head || list_empty(head))
         return 0;
 
-    if (list_is_singular(head))
-        return q_size(list_first_entry(head, queue_contex_t, chain)->q);
-
-    LIST_HEAD(ans);
-    queue_contex_t *q_ptr = NULL;
-    queue_contex_t *last_q_ptr = list_last_entry(head, queue_contex_t, chain);
-    int size;
+    queue_contex_t *first = list_first_entry(head, queue_contex_t, chain);
+    queue_contex_t *ctx = NULL;
+    int k = 0;
+    list_for_each_entry (ctx, head, chain) {
+        q_normalize(ctx->q);
+        k++;
+    }
 
-    list_for_each_entry (q_ptr, head, chain) {
-        if (q_ptr == last_q_ptr) {
-            list_splice_init(q_ptr->q, &ans);
-            break;
+    /* A min-heap over the heads of the queues makes a k-way merge which
+     * moves every element once, in O(N log k). The heap lives on the stack,
+     * as q_merge() must not allocate; longer chains are merged in rounds,
+     * MERGE_FANOUT queues at a time, each round into the first queue of
+     * its group.
+     */
+    for (int stride = 1; stride < k; stride *= MERGE_FANOUT) {
+        merge_src_t heap[MERGE_FANOUT];
+        queue_contex_t *dst = NULL;
+        int n = 0, j = 0;
+
+        list_for_each_entry (ctx, head, chain) {
+            if (j % stride == 0) {
+                if (j % (stride * MERGE_FANOUT) == 0) {
+                    if (dst)
+                        merge_heap(heap, n, dst, descend);
+                    dst = ctx;
+                    n = 0;
+                }
+                if (!list_empty(ctx->q))
+                    heap[n++] = (merge_src_t){.ctx = ctx, .order = j};
+            }
+            j++;
         }
-
-        list_splice_init(q_ptr->q, &ans);
-        list_splice_init(last_q_ptr->q, &ans);
-        last_q_ptr = list_entry(last_q_ptr->chain.prev, queue_contex_t, chain);
+        merge_heap(heap, n, dst, descend);
     }
 
-    q_sort(&ans, descend);
-    size = q_size(&ans);
-    list_splice_init(&ans, list_first_entry(head, queue_contex_t, chain)->q);
-
-    return size;
+    return q_size(first->q);
 }
@@ -17,14 +17,24 @@
  * element_t - Linked list element
  * @value: pointer to array holding string
  * @list: node of a doubly-linked list
+ * @data: inline storage for the string, placed right behind @list
  *
- * @value needs to be explicitly allocated and freed
+ * The element and the bytes of its string are carved out of one allocation,
+ * with @value pointing at @data, so a single free releases both. In interning
+ * mode @value refers to the copy held by the string arena instead, and
+ * elements loaded by qfile_load() point into the mapping of their file; @data
+ * then only holds ELEMENT_INTERNED or ELEMENT_MAPPED.
  */
 typedef struct {
     char *value;
     struct list_head list;
+    char data[];
 } element_t;
 
+/* Where the string of an element lives when @value does not point at @data */
+#define ELEMENT_INTERNED 1
+#define ELEMENT_MAPPED 2
+
 /**
  * queue_contex_t - The context managing a chain of queues
  * @q: pointer to the head of the queue
@@ -39,6 +49,31 @@ typedef struct {
     int id;
 } queue_contex_t;
 
+/**
+ * queue_head_t - The header of a queue, maintained by the q_* operations
+ * @head: head of the circular doubly-linked list holding the elements
+ * @size: the number of elements currently linked to @head
+ * @index: positional index over the elements, NULL unless enabled
+ * @lazy_reverse: whether q_reverse() only flips @reversed
+ * @reversed: whether the elements are linked from tail to head
+ *
+ * q_new() allocates a queue_head_t and hands out a pointer to its @head
+ * member, so the rest of the interface keeps working on struct list_head.
+ * Every operation that links or unlinks elements keeps @size up to date,
+ * which makes q_size() constant time. Such operations must therefore only
+ * be given lists created by q_new().
+ *
+ * While @reversed is set, the first element of the queue is the one at
+ * @head.prev, and the rest follow through the prev pointers.
+ */
+typedef struct {
+    struct list_head head;
+    int size;
+    struct skiplist *index;
+    bool lazy_reverse;
+    bool reversed;
+} queue_head_t;
+
 /* Operations on queue */
 
 /**
@@ -78,6 +113,35 @@ bool q_insert_head(struct list_head *head, char *s);
  */
 bool q_insert_tail(struct list_head *head, char *s);
 
+/**
+ * q_insert_head_bulk() - Insert a batch of elements in the head
+ * @head: header of queue
+ * @s: array of strings would be inserted
+ * @n: number of strings in @s
+ *
+ * Same result as calling q_insert_head() on s[0] to s[n - 1] in turn, so
+ * s[n - 1] ends up at the head. The new elements are linked into a private
+ * list first, which is spliced into the queue in one step. Each of them is
+ * still allocated on its own, as q_insert_head() does. Either all of them
+ * are inserted, or the queue is left untouched.
+ *
+ * Return: true for success, false for allocation failed or queue is NULL
+ */
+bool q_insert_head_bulk(struct list_head *head, char **s, int n);
+
+/**
+ * q_insert_tail_bulk() - Insert a batch of elements at the tail
+ * @head: header of queue
+ * @s: array of strings would be inserted
+ * @n: number of strings in @s
+ *
+ * Same result as calling q_insert_tail() on s[0] to s[n - 1] in turn.
+ * Either all of the elements are inserted, or the queue is left untouched.
+ *
+ * Return: true for success, false for allocation failed or queue is NULL
+ */
+bool q_insert_tail_bulk(struct list_head *head, char **s, int n);
+
 /**
  * q_remove_head() - Remove the element from head of queue
  * @head: header of queue
@@ -108,26 +172,142 @@ element_t *q_remove_head(struct list_head *head, char *sp, size_t bufsize);
  */
 element_t *q_remove_tail(struct list_head *head, char *sp, size_t bufsize);
 
+/**
+ * q_remove_head_n() - Remove a run of elements from head of queue
+ * @head: header of queue
+ * @n: number of elements to remove
+ * @list: list the removed elements are appended to
+ *
+ * The first @n elements, or all of them if the queue is shorter, are cut off
+ * with list_cut_position() and spliced to the tail of @list in their original
+ * order. As with q_remove_head(), the elements are unlinked but not freed;
+ * the caller releases them, e.g. with q_release_element().
+ *
+ * Return: the number of elements removed, zero if queue is NULL or empty.
+ */
+int q_remove_head_n(struct list_head *head, int n, struct list_head *list);
+
+/**
+ * q_splice_tail() - Move a list of elements to the tail of queue
+ * @head: header of queue
+ * @list: list of element_t, not a queue, left empty
+ * @n: number of elements on @list
+ *
+ * The counterpart of q_remove_head_n(): the elements follow the last one of
+ * the queue in the order they have on @list.
+ *
+ * Return: true for success, false if queue or @list is NULL
+ */
+bool q_splice_tail(struct list_head *head, struct list_head *list, int n);
+
 /**
  * q_release_element() - Release the element
  * @e: element would be released
  *
- * This function is intended for internal use only.
+ * This function is intended for internal use only. A string shared through
+ * the interning arena or a mapped file only loses a reference.
  */
-static inline void q_release_element(element_t *e)
-{
-    test_free(e->value);
-    test_free(e);
-}
+void q_release_element(element_t *e);
 
 /**
  * q_size() - Get the size of the queue
  * @head: header of queue
  *
+ * The length is read from the queue_head_t rather than counted, so this
+ * runs in constant time.
+ *
  * Return: the number of elements in queue, zero if queue is NULL or empty
  */
 int q_size(struct list_head *head);
 
+/**
+ * q_set_indexed() - Enable or disable the positional index of a queue
+ * @head: header of queue
+ * @indexed: whether the queue keeps an index
+ *
+ * An indexed queue maintains a skip list over its elements, which makes
+ * q_at(), q_delete_at() and q_delete_mid() run in O(log n). Insertion and
+ * removal at either end keep the index up to date; other operations mark it
+ * stale, and it is rebuilt in one pass by the next positional lookup.
+ *
+ * Return: true for success, false for allocation failed or queue is NULL
+ */
+bool q_set_indexed(struct list_head *head, bool indexed);
+
+/**
+ * q_reordered() - Tell a queue its elements were relinked
+ * @head: header of queue
+ *
+ * sort_list() and merge2list() work on any list of element_t, so they do not
+ * know about the index of a queue. Callers sorting a queue with them, or
+ * relinking its elements by any means other than the remaining q_*
+ * operations, have to call this function afterwards. It neither allocates
+ * nor frees.
+ */
+void q_reordered(struct list_head *head);
+
+/**
+ * q_set_lazy_reverse() - Enable or disable lazy reversal of a queue
+ * @head: header of queue
+ * @lazy: whether q_reverse() is deferred
+ *
+ * In lazy mode q_reverse() runs in constant time: it only flips the direction
+ * of the queue, and the elements stay linked as they are. Insertion and
+ * removal at either end, positional lookups, q_delete_dup(), q_ascend(),
+ * q_descend() and sorting, see q_reversed(), work in either direction, and
+ * so do q_swap() on an even number of elements and q_delete_dup_unsorted()
+ * when all copies go. The other operations put the elements back in
+ * head-to-tail order first, which costs one pass if a reversal is pending.
+ * Disabling the mode does the same.
+ *
+ * Return: true for success, false if queue is NULL
+ */
+bool q_set_lazy_reverse(struct list_head *head, bool lazy);
+
+/**
+ * q_reversed() - Whether a queue is linked from tail to head
+ * @head: header of queue
+ *
+ * Code walking the elements of a queue directly, rather than through the q_*
+ * operations, steps through the prev pointers from @head while this is true.
+ * q_sort() takes care of it, but any sort of a plain list, such as
+ * sort_list(), has to be done in the opposite direction on such a queue, i.e.
+ * with @descend != q_reversed().
+ *
+ * Return: true if a lazy reversal is pending, false if queue is NULL
+ */
+bool q_reversed(struct list_head *head);
+
+/**
+ * q_normalize() - Apply a pending lazy reversal
+ * @head: header of queue
+ *
+ * Relinks the elements from head to tail if q_reversed() is true, so the
+ * list can be handed to code which only walks forward. Neither allocates nor
+ * frees.
+ */
+void q_normalize(struct list_head *head);
+
+/**
+ * q_at() - Get the element at a position of the queue
+ * @head: header of queue
+ * @i: 0-based position, counted from the head
+ *
+ * Runs in O(log n) on an indexed queue, otherwise walks from the closer end.
+ *
+ * Return: the element, %NULL if queue is NULL or @i is out of range
+ */
+element_t *q_at(struct list_head *head, int i);
+
+/**
+ * q_delete_at() - Delete the element at a position of the queue
+ * @head: header of queue
+ * @i: 0-based position, counted from the head
+ *
+ * Return: true for success, false if queue is NULL or @i is out of range
+ */
+bool q_delete_at(struct list_head *head, int i);
+
 /**
  * q_delete_mid() - Delete the middle node in queue
  * @head: header of queue
@@ -155,6 +335,21 @@ bool q_delete_mid(struct list_head *head);
  */
 bool q_delete_dup(struct list_head *head);
 
+/**
+ * q_delete_dup_unsorted() - Delete duplicate strings from a queue in any order
+ * @head: header of queue
+ * @keep_first: keep the first occurrence of each duplicated string
+ *
+ * Unlike q_delete_dup(), the queue does not need to be sorted: the strings
+ * are counted in a hash table in one pass, and a second pass deletes every
+ * element whose string occurs more than once, or every one but the first
+ * if @keep_first is set. The survivors keep their order. The table needs
+ * O(n) memory; if it cannot be allocated, the queue is left untouched.
+ *
+ * Return: true for success, false if list is NULL or allocation failed.
+ */
+bool q_delete_dup_unsorted(struct list_head *head, bool keep_first);
+
 /**
  * q_swap() - Swap every two adjacent nodes
  * @head: header of queue
@@ -171,7 +366,8 @@ void q_swap(struct list_head *head);
  * No effect if queue is NULL or empty.
  * This function should not allocate or free any list elements
  * (e.g., by calling q_insert_head, q_insert_tail, or q_remove_head).
- * It should rearrange the existing ones.
+ * It should rearrange the existing ones. In lazy mode, see
+ * q_set_lazy_reverse(), it only flips the direction of the queue.
  */
 void q_reverse(struct list_head *head);
 
@@ -196,10 +392,38 @@ void q_reverseK(struct list_head *head, int k);
  * @descend: whether or not to sort in descending order
  *
  * No effect if queue is NULL or empty. If there has only one element, do
- * nothing.
+ * nothing. A pending lazy reversal is taken into account, and the index of
+ * the queue is kept up to date.
  */
 void q_sort(struct list_head *head, bool descend);
 
+/**
+ * sort_list() - Sort a list of element_t
+ * @head: header of the list
+ * @descend: whether or not to sort in descending order
+ *
+ * The stable natural merge sort behind q_sort(), for lists which are not
+ * queues, such as the segments psort() cuts a queue into. It knows nothing
+ * about sizes, indexes or lazy reversal.
+ */
+void sort_list(struct list_head *head, bool descend);
+
+/**
+ * merge2list() - Merge two sorted lists of elements
+ * @left_head: header of the first sorted list
+ * @right_head: header of the second sorted list
+ * @head: header of the list the merged elements are appended to
+ * @descend: whether the lists are sorted in descending order
+ *
+ * Both inputs are emptied. On equal values the elements of @left_head go
+ * first, which keeps a merge of adjacent segments stable. Like sort_list(), it
+ * works on any list of element_t and leaves sizes to the caller.
+ */
+void merge2list(struct list_head *left_head,
+                struct list_head *right_head,
+                struct list_head *head,
+                bool descend);
+
 /**
  * q_ascend() - Remove every node which has a node with a strictly less
  * value anywhere to the right side of it.
@@ -0,0 +1,106 @@
+#include <string.h>
+
+#include "queue.h"
+#include "radix_sort.h"
+
+/* Buckets with fewer elements than this are merge sorted instead */
+#define RADIX_CUTOFF 32
+
+/* Deepest byte position distributed into buckets, bounding the stack usage */
+#define RADIX_MAX_DEPTH 64
+
+static inline const char *key(const struct list_head *node)
+{
+    return list_entry(node, element_t, list)->value;
+}
+
+/* Stable merge sort of n elements comparing their values from depth on */
+static void merge_sort(struct list_head *head,
+                       int n,
+                       size_t depth,
+                       bool descend)
+{
+    if (n < 2)
+        return;
+
+    struct list_head *mid = head;
+    for (int i = 0; i < n / 2; i++)
+        mid = mid->next;
+
+    LIST_HEAD(left);
+    list_cut_position(&left, head, mid);
+    merge_sort(&left, n / 2, depth, descend);
+    merge_sort(head, n - n / 2, depth, descend);
+
+    LIST_HEAD(merged);
+    while (!list_empty(&left) && !list_empty(head)) {
+        int cmp = strcmp(key(left.next) + depth, key(head->next) + depth);
+        /* if equal, take 'left' -- important for sort stability */
+        if (descend ? cmp >= 0 : cmp <= 0)
+            list_move_tail(left.next, &merged);
+        else
+            list_move_tail(head->next, &merged);
+    }
+    list_splice_tail_init(&left, &merged);
+    list_splice_tail_init(head, &merged);
+    list_splice(&merged, head);
+}
+
+/* Sort n elements whose values share their first depth bytes */
+static void msd_sort(struct list_head *head,
+                     int n,
+                     size_t depth,
+                     bool descend)
+{
+    struct list_head buckets[256];
+    int counts[256];
+
+    for (;;) {
+        if (n < RADIX_CUTOFF || depth >= RADIX_MAX_DEPTH) {
+            merge_sort(head, n, depth, descend);
+            return;
+        }
+
+        for (int c = 0; c < 256; c++) {
+            INIT_LIST_HEAD(&buckets[c]);
+            counts[c] = 0;
+        }
+
+        struct list_head *node, *safe;
+        list_for_each_safe (node, safe, head) {
+            unsigned char c = key(node)[depth];
+            list_move_tail(node, &buckets[c]);
+            counts[c]++;
+        }
+
+        /* All values share one more byte: go deeper without recursion */
+        int c = 1;
+        while (c < 256 && counts[c] != n)
+            c++;
+        if (c == 256)
+            break;
+        list_splice(&buckets[c], head);
+        depth++;
+    }
+
+    /* Values which ended at this depth are all equal and sort first */
+    for (int i = 0; i < 256; i++) {
+        int c = descend ? 255 - i : i;
+        if (c && counts[c] > 1)
+            msd_sort(&buckets[c], counts[c], depth + 1, descend);
+        list_splice_tail(&buckets[c], head);
+    }
+}
+
+void radix_sort(struct list_head *head, bool descend)
+{
+    if (!head || list_empty(head) || list_is_singular(head))
+        return;
+
+    int n = 0;
+    struct list_head *node;
+    list_for_each (node, head)
+        n++;
+
+    msd_sort(head, n, 0, descend);
+}
@@ -0,0 +1,22 @@
+#ifndef LAB0_RADIX_SORT_H
+#define LAB0_RADIX_SORT_H
+
+#include <stdbool.h>
+
+#include "list.h"
+
+/**
+ * radix_sort() - Sort a list of element_t by their string values
+ * @head: header of the list
+ * @descend: whether or not to sort in descending order
+ *
+ * Most-significant-digit radix sort: the elements are distributed into 256
+ * buckets by their byte at the current depth, each bucket is sorted on the
+ * following bytes, and the buckets are concatenated again. Small buckets and
+ * buckets beyond a maximum depth are finished by a merge sort on the
+ * remaining suffixes. The sort is stable, allocates nothing and only relinks
+ * the existing nodes.
+ */
+void radix_sort(struct list_head *head, bool descend);
+
+#endif /* LAB0_RADIX_SORT_H */
@@ -0,0 +1,191 @@
+#include <string.h>
+
+#include "harness.h"
+#include "ring.h"
+
+/* Slot holding the i-th value from head */
+#define RQ_SLOT(q, i) ((q)->buf[((q)->head + (i)) & (q)->mask])
+
+/* Create an empty queue */
+ring_queue_t *rq_new()
+{
+    ring_queue_t *q = malloc(sizeof(*q));
+    if (!q)
+        return NULL;
+
+    q->buf = malloc(sizeof(char *) * RQ_MIN_CAPACITY);
+    if (!q->buf) {
+        free(q);
+        return NULL;
+    }
+    q->mask = RQ_MIN_CAPACITY - 1;
+    q->head = 0;
+    q->size = 0;
+    return q;
+}
+
+/* Free all storage used by queue */
+void rq_free(ring_queue_t *q)
+{
+    if (!q)
+        return;
+
+    for (int i = 0; i < q->size; i++)
+        free(RQ_SLOT(q, i));
+    free(q->buf);
+    free(q);
+}
+
+/* Double the capacity, unwrapping the values to the start of the new array */
+static bool rq_grow(ring_queue_t *q)
+{
+    size_t cap = q->mask + 1;
+    char **buf = malloc(sizeof(char *) * cap * 2);
+    if (!buf)
+        return false;
+
+    size_t first = cap - q->head;
+    if (first > (size_t) q->size)
+        first = q->size;
+    memcpy(buf, q->buf + q->head, sizeof(char *) * first);
+    memcpy(buf + first, q->buf, sizeof(char *) * (q->size - first));
+
+    free(q->buf);
+    q->buf = buf;
+    q->mask = cap * 2 - 1;
+    q->head = 0;
+    return true;
+}
+
+/* Copy s and make sure there is room for one more value */
+static char *rq_prepare(ring_queue_t *q, const char *s)
+{
+    char *value = strdup(s);
+    if (!value)
+        return NULL;
+
+    if ((size_t) q->size > q->mask && !rq_grow(q)) {
+        free(value);
+        return NULL;
+    }
+    return value;
+}
+
+/* Insert a copy of s at head of queue */
+bool rq_insert_head(ring_queue_t *q, const char *s)
+{
+    if (!q)
+        return false;
+
+    char *value = rq_prepare(q, s);
+    if (!value)
+        return false;
+
+    q->head = (q->head - 1) & q->mask;
+    q->buf[q->head] = value;
+    q->size++;
+    return true;
+}
+
+/* Insert a copy of s at tail of queue */
+bool rq_insert_tail(ring_queue_t *q, const char *s)
+{
+    if (!q)
+        return false;
+
+    char *value = rq_prepare(q, s);
+    if (!value)
+        return false;
+
+    RQ_SLOT(q, q->size) = value;
+    q->size++;
+    return true;
+}
+
+/* Copy out and free a value taken from the queue */
+static void take_value(char *value, char *sp, size_t bufsize)
+{
+    if (sp && bufsize) {
+        strncpy(sp, value, bufsize);
+        sp[bufsize - 1] = '\0';
+    }
+    free(value);
+}
+
+/* Remove the value at head of queue */
+bool rq_remove_head(ring_queue_t *q, char *sp, size_t bufsize)
+{
+    if (!q || !q->size)
+        return false;
+
+    take_value(q->buf[q->head], sp, bufsize);
+    q->head = (q->head + 1) & q->mask;
+    q->size--;
+    return true;
+}
+
+/* Remove the value at tail of queue */
+bool rq_remove_tail(ring_queue_t *q, char *sp, size_t bufsize)
+{
+    if (!q || !q->size)
+        return false;
+
+    q->size--;
+    take_value(RQ_SLOT(q, q->size), sp, bufsize);
+    return true;
+}
+
+/* Return the number of values in queue */
+int rq_size(ring_queue_t *q)
+{
+    return q ? q->size : 0;
+}
+
+/* Reverse the values from the from-th to the (to - 1)-th one */
+static void rq_reverse_range(ring_queue_t *q, int from, int to)
+{
+    for (int lo = from, hi = to - 1; lo < hi; lo++, hi--) {
+        char *tmp = RQ_SLOT(q, lo);
+        RQ_SLOT(q, lo) = RQ_SLOT(q, hi);
+        RQ_SLOT(q, hi) = tmp;
+    }
+}
+
+/* Reverse the values in queue */
+void rq_reverse(ring_queue_t *q)
+{
+    if (q)
+        rq_reverse_range(q, 0, q->size);
+}
+
+/* Swap every two adjacent values */
+void rq_swap(ring_queue_t *q)
+{
+    if (!q)
+        return;
+
+    for (int i = 0; i + 1 < q->size; i += 2)
+        rq_reverse_range(q, i, i + 2);
+}
+
+/* Reverse the values k at a time */
+void rq_reverseK(ring_queue_t *q, int k)
+{
+    if (!q || k <= 1)
+        return;
+
+    for (int i = 0; i + k <= q->size; i += k)
+        rq_reverse_range(q, i, i + k);
+}
+
+/* Call fn on every value from head to tail */
+void rq_for_each(ring_queue_t *q,
+                 void (*fn)(const char *, void *),
+                 void *arg)
+{
+    if (!q)
+        return;
+
+    for (int i = 0; i < q->size; i++)
+        fn(RQ_SLOT(q, i), arg);
+}
@@ -0,0 +1,74 @@
+#ifndef LAB0_RING_H
+#define LAB0_RING_H
+
+/* Growable ring-buffer deque.
+ *
+ * The values live in one contiguous array of string pointers whose capacity
+ * is a power of two, indexed modulo the capacity from the position of the
+ * head. Both ends are O(1); when the array is full it doubles, which keeps
+ * insertion amortized O(1). Rearranging operations are plain index arithmetic
+ * over the array.
+ *
+ * This is a structure for benchmarks only, not a backend of the queue. The
+ * operations behave like their q_* counterparts in queue.h, but only the
+ * 'bench' command and the constant-time simulation of 'option ring' run
+ * them; the queue commands and their traces always use queue.c.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define RQ_MIN_CAPACITY 16
+
+/**
+ * ring_queue_t - A ring-buffer deque
+ * @buf: array of pointers to strings owned by the queue
+ * @mask: capacity of @buf minus one
+ * @head: index of the first value in @buf
+ * @size: the number of values in the queue
+ */
+typedef struct {
+    char **buf;
+    size_t mask;
+    size_t head;
+    int size;
+} ring_queue_t;
+
+/* Create an empty queue, NULL for allocation failed */
+ring_queue_t *rq_new();
+
+/* Free all storage used by queue, no effect if q is NULL */
+void rq_free(ring_queue_t *q);
+
+/* Insert a copy of s at head/tail of queue.
+ * Return false for allocation failed or queue is NULL.
+ */
+bool rq_insert_head(ring_queue_t *q, const char *s);
+bool rq_insert_tail(ring_queue_t *q, const char *s);
+
+/* Remove the value at head/tail of queue and free it.
+ * If sp is non-NULL, the value is copied to it first, with at most
+ * bufsize - 1 characters plus a null terminator.
+ * Return false if queue is NULL or empty.
+ */
+bool rq_remove_head(ring_queue_t *q, char *sp, size_t bufsize);
+bool rq_remove_tail(ring_queue_t *q, char *sp, size_t bufsize);
+
+/* Return the number of values in queue, zero if queue is NULL */
+int rq_size(ring_queue_t *q);
+
+/* Reverse the values in queue */
+void rq_reverse(ring_queue_t *q);
+
+/* Swap every two adjacent values */
+void rq_swap(ring_queue_t *q);
+
+/* Reverse the values k at a time, leaving a shorter remainder in place */
+void rq_reverseK(ring_queue_t *q, int k);
+
+/* Call fn on every value from head to tail */
+void rq_for_each(ring_queue_t *q,
+                 void (*fn)(const char *, void *),
+                 void *arg);
+
+#endif /* LAB0_RING_H */
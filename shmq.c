@@ -0,0 +1,441 @@
+/* Queue of strings in a POSIX shared memory object */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* A queue handle is shared by no one but its process, keep it off the
+ * harness like the region itself
+ */
+#define INTERNAL 1
+#include "harness.h"
+
+#include "shmq.h"
+
+/* Blocks range from 1 << SHMQ_ORDER_MIN bytes up to 1 << (SHMQ_ORDERS - 1) */
+#define SHMQ_ORDER_MIN 5
+#define SHMQ_ORDERS 48
+
+/* Blocks and the heap are aligned to this many bytes */
+#define SHMQ_ALIGN 64
+
+/**
+ * shmq_header_t - Start of the shared region
+ * @magic: SHMQ_MAGIC with its NUL terminator
+ * @version: SHMQ_VERSION
+ * @size: bytes of the region
+ * @lock: guards everything below
+ * @nonempty: signalled when an element is inserted or on shutdown
+ * @space: signalled when a block is released
+ * @list: links of the list sentinel, offsets like those of an element
+ * @count: elements in the list
+ * @shutdown: set by shmq_shutdown()
+ * @brk: offset of the unused end of the heap
+ * @free: offset of the first free block of each order, 0 for none
+ * @used: blocks of each order held by elements, in the queue or removed
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint64_t size;
+    pthread_mutex_t lock;
+    pthread_cond_t nonempty;
+    pthread_cond_t space;
+    uint64_t list[2];
+    int count;
+    bool shutdown;
+    uint64_t brk;
+    uint64_t free[SHMQ_ORDERS];
+    uint64_t used[SHMQ_ORDERS];
+} shmq_header_t;
+
+/**
+ * struct shmq - A mapping of a shared queue in this process
+ * @h: the region, starting with its header
+ * @size: bytes mapped
+ */
+struct shmq {
+    shmq_header_t *h;
+    size_t size;
+};
+
+/* The sentinel sits where @next of an element would */
+#define LIST_OFF offsetof(shmq_header_t, list)
+
+#define HEAP_OFF \
+    ((sizeof(shmq_header_t) + SHMQ_ALIGN - 1) & ~(uint64_t) (SHMQ_ALIGN - 1))
+
+static inline shmq_elem_t *at(const shmq_t *q, uint64_t off)
+{
+    return (shmq_elem_t *) ((char *) q->h + off);
+}
+
+static inline uint64_t off_of(const shmq_t *q, const void *p)
+{
+    return (const char *) p - (const char *) q->h;
+}
+
+/* Order of the smallest block holding a string of len bytes */
+static int order_of(size_t len)
+{
+    size_t need = sizeof(shmq_elem_t) + len + 1;
+    int order = SHMQ_ORDER_MIN;
+    while (order < SHMQ_ORDERS && ((size_t) 1 << order) < need)
+        order++;
+    return order;
+}
+
+/* Offset where a block of the given order would be carved off the unused
+ * end of the heap, 0 if it does not fit there
+ */
+static uint64_t brk_fit(const shmq_header_t *h, int order)
+{
+    uint64_t bytes = (uint64_t) 1 << order;
+    uint64_t start = (h->brk + SHMQ_ALIGN - 1) & ~(uint64_t) (SHMQ_ALIGN - 1);
+    if (bytes < SHMQ_ALIGN)
+        start = h->brk;
+    if (start > h->size || bytes > h->size - start)
+        return 0;
+    return start;
+}
+
+/* Take a block of the given order, 0 if the heap is full */
+static uint64_t block_alloc(shmq_t *q, int order)
+{
+    shmq_header_t *h = q->h;
+    uint64_t off = h->free[order];
+    if (off) {
+        h->free[order] = at(q, off)->next;
+    } else {
+        off = brk_fit(h, order);
+        if (!off)
+            return 0;
+        h->brk = off + ((uint64_t) 1 << order);
+    }
+    h->used[order]++;
+    return off;
+}
+
+/* Whether a block of the given order can ever be had. Blocks are neither
+ * split nor merged, so once the unused end of the heap is too short, only
+ * the blocks of that very order which are held now can come back.
+ */
+static bool block_possible(const shmq_header_t *h, int order)
+{
+    return h->free[order] || h->used[order] || brk_fit(h, order);
+}
+
+/* Bring the list back in shape after a process died holding the lock, maybe
+ * halfway through relinking an element: follow the forward links, which
+ * every update sets first, and rebuild the backward links and the count.
+ */
+static void repair(shmq_t *q)
+{
+    shmq_header_t *h = q->h;
+    uint64_t prev = LIST_OFF;
+    int count = 0;
+    for (uint64_t off = h->list[0]; off != LIST_OFF; off = at(q, off)->next) {
+        if (off < HEAP_OFF || off > h->size - sizeof(shmq_elem_t)) {
+            /* A torn link: drop the rest of the list */
+            at(q, prev)->next = LIST_OFF;
+            break;
+        }
+        at(q, off)->prev = prev;
+        prev = off;
+        count++;
+    }
+    h->list[1] = prev;
+    h->count = count;
+}
+
+/* Lock the region, taking the lock over from a process which died with it */
+static void region_lock(shmq_t *q)
+{
+    if (pthread_mutex_lock(&q->h->lock) == EOWNERDEAD) {
+        repair(q);
+        pthread_mutex_consistent(&q->h->lock);
+    }
+}
+
+static void region_unlock(shmq_t *q)
+{
+    pthread_mutex_unlock(&q->h->lock);
+}
+
+/* Deadline timeout_ms from now on the clock of the condition variables */
+static void deadline_in(struct timespec *ts, long timeout_ms)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += timeout_ms / 1000;
+    ts->tv_nsec += timeout_ms % 1000 * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+/* Wait on cond with the region locked, until the deadline unless it is NULL.
+ * Return 0 when woken up, ETIMEDOUT past the deadline.
+ */
+static int region_wait(shmq_t *q,
+                       pthread_cond_t *cond,
+                       const struct timespec *deadline)
+{
+    int err = deadline ? pthread_cond_timedwait(cond, &q->h->lock, deadline)
+                       : pthread_cond_wait(cond, &q->h->lock);
+    if (err == EOWNERDEAD) {
+        repair(q);
+        pthread_mutex_consistent(&q->h->lock);
+        err = 0;
+    }
+    return err;
+}
+
+static shmq_t *map_region(int fd, size_t size)
+{
+    shmq_t *q = malloc(sizeof(shmq_t));
+    if (!q) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    q->h = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (q->h == MAP_FAILED) {
+        int err = errno;
+        free(q);
+        errno = err;
+        return NULL;
+    }
+    q->size = size;
+    return q;
+}
+
+/* Set up the header of a new region */
+static bool init_header(shmq_header_t *h, size_t size)
+{
+    pthread_mutexattr_t ma;
+    pthread_condattr_t ca;
+    pthread_mutexattr_init(&ma);
+    pthread_mutexattr_setpshared(&ma, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&ma, PTHREAD_MUTEX_ROBUST);
+    pthread_condattr_init(&ca);
+    pthread_condattr_setpshared(&ca, PTHREAD_PROCESS_SHARED);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+
+    int err = pthread_mutex_init(&h->lock, &ma);
+    if (!err)
+        err = pthread_cond_init(&h->nonempty, &ca);
+    if (!err)
+        err = pthread_cond_init(&h->space, &ca);
+    pthread_mutexattr_destroy(&ma);
+    pthread_condattr_destroy(&ca);
+    if (err) {
+        errno = err;
+        return false;
+    }
+
+    h->version = SHMQ_VERSION;
+    h->size = size;
+    h->list[0] = h->list[1] = LIST_OFF;
+    h->brk = HEAP_OFF;
+    memcpy(h->magic, SHMQ_MAGIC, sizeof(h->magic));
+    return true;
+}
+
+shmq_t *shmq_create(const char *name, size_t size)
+{
+    if (size < SHMQ_SIZE_MIN)
+        size = SHMQ_SIZE_MIN;
+    size = (size + SHMQ_SIZE_MIN - 1) & ~(size_t) (SHMQ_SIZE_MIN - 1);
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        return NULL;
+
+    shmq_t *q = NULL;
+    if (!ftruncate(fd, size))
+        q = map_region(fd, size);
+    int err = errno;
+    close(fd);
+    if (q && !init_header(q->h, size)) {
+        err = errno;
+        shmq_detach(q);
+        q = NULL;
+    }
+    if (!q) {
+        shm_unlink(name);
+        errno = err;
+    }
+    return q;
+}
+
+shmq_t *shmq_attach(const char *name)
+{
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    shmq_t *q = NULL;
+    if (!fstat(fd, &st)) {
+        if (st.st_size < (off_t) HEAP_OFF)
+            errno = EINVAL;
+        else
+            q = map_region(fd, st.st_size);
+    }
+    int err = errno;
+    close(fd);
+
+    if (q && (memcmp(q->h->magic, SHMQ_MAGIC, sizeof(q->h->magic)) ||
+              q->h->version != SHMQ_VERSION || q->h->size != q->size)) {
+        shmq_detach(q);
+        q = NULL;
+        err = EINVAL;
+    }
+    errno = err;
+    return q;
+}
+
+void shmq_detach(shmq_t *q)
+{
+    if (!q)
+        return;
+    munmap(q->h, q->size);
+    free(q);
+}
+
+bool shmq_unlink(const char *name)
+{
+    return !shm_unlink(name);
+}
+
+/* Insert a copy of s at the tail or at the head */
+static bool insert(shmq_t *q, const char *s, long timeout_ms, bool at_tail)
+{
+    size_t len = strlen(s);
+    int order = order_of(len);
+    if (order == SHMQ_ORDERS ||
+        ((uint64_t) 1 << order) > q->h->size - HEAP_OFF) {
+        errno = E2BIG;
+        return false;
+    }
+
+    struct timespec deadline;
+    if (timeout_ms > 0)
+        deadline_in(&deadline, timeout_ms);
+
+    shmq_header_t *h = q->h;
+    region_lock(q);
+    uint64_t off;
+    int err = 0;
+    while (!(off = block_alloc(q, order))) {
+        if (!block_possible(h, order))
+            err = ENOMEM;
+        else if (!timeout_ms)
+            err = EAGAIN;
+        else
+            err = region_wait(q, &h->space, timeout_ms > 0 ? &deadline : NULL);
+        if (err)
+            break;
+    }
+    if (!off) {
+        region_unlock(q);
+        errno = err;
+        return false;
+    }
+
+    shmq_elem_t *e = at(q, off);
+    e->order = order;
+    e->len = len;
+    memcpy(e->value, s, len + 1);
+
+    /* Forward links first, as repair() follows them */
+    uint64_t prev = at_tail ? h->list[1] : LIST_OFF;
+    uint64_t next = at(q, prev)->next;
+    e->prev = prev;
+    e->next = next;
+    at(q, prev)->next = off;
+    at(q, next)->prev = off;
+    h->count++;
+
+    pthread_cond_signal(&h->nonempty);
+    region_unlock(q);
+    return true;
+}
+
+bool shmq_insert_tail(shmq_t *q, const char *s, long timeout_ms)
+{
+    return insert(q, s, timeout_ms, true);
+}
+
+bool shmq_insert_head(shmq_t *q, const char *s, long timeout_ms)
+{
+    return insert(q, s, timeout_ms, false);
+}
+
+shmq_elem_t *shmq_remove_head(shmq_t *q, long timeout_ms)
+{
+    struct timespec deadline;
+    if (timeout_ms > 0)
+        deadline_in(&deadline, timeout_ms);
+
+    shmq_header_t *h = q->h;
+    region_lock(q);
+    int err = 0;
+    while (!h->count && !err) {
+        if (h->shutdown)
+            err = EPIPE;
+        else if (!timeout_ms)
+            err = EAGAIN;
+        else
+            err = region_wait(q, &h->nonempty,
+                              timeout_ms > 0 ? &deadline : NULL);
+    }
+
+    shmq_elem_t *e = NULL;
+    if (h->count) {
+        e = at(q, h->list[0]);
+        h->list[0] = e->next;
+        at(q, e->next)->prev = LIST_OFF;
+        h->count--;
+    }
+    region_unlock(q);
+    if (!e)
+        errno = err;
+    return e;
+}
+
+void shmq_release(shmq_t *q, shmq_elem_t *e)
+{
+    if (!e)
+        return;
+
+    shmq_header_t *h = q->h;
+    region_lock(q);
+    e->next = h->free[e->order];
+    h->free[e->order] = off_of(q, e);
+    h->used[e->order]--;
+    pthread_cond_broadcast(&h->space);
+    region_unlock(q);
+}
+
+void shmq_shutdown(shmq_t *q)
+{
+    region_lock(q);
+    q->h->shutdown = true;
+    pthread_cond_broadcast(&q->h->nonempty);
+    region_unlock(q);
+}
+
+int shmq_size(shmq_t *q)
+{
+    region_lock(q);
+    int count = q->h->count;
+    region_unlock(q);
+    return count;
+}
@@ -0,0 +1,105 @@
+#ifndef LAB0_SHMQ_H
+#define LAB0_SHMQ_H
+
+/* Queue of strings in a POSIX shared memory object, shared across processes.
+ *
+ * The region created by shmq_create() holds a header followed by a heap.
+ * Every element is a single block of the heap carrying its links and its
+ * string, and the links are offsets from the start of the region rather than
+ * pointers, so they stay valid in every process that maps the region,
+ * wherever the mapping lands. Blocks come in power-of-two sizes, taken from
+ * a free list per size or carved off the unused end of the heap, and are put
+ * back on their free list when released. Free blocks are never split or
+ * merged, which suits strings of similar lengths; an insertion needing a
+ * block size which can never come back fails rather than waiting for it.
+ *
+ * Any process attaching the region by name can insert and remove elements.
+ * A removed element stays in the region: the consumer reads the string in
+ * place and hands the block back with shmq_release(), so the string is never
+ * copied on its way from one process to another. The header and the heap are
+ * guarded by a single process-shared robust mutex, with condition variables
+ * to wait for an element or for room in the heap. When a process dies holding
+ * the mutex, the next one to take it rebuilds the list from its forward
+ * links; an element being inserted or removed at that moment may be lost.
+ *
+ * Waits take a timeout in milliseconds: 0 not to wait, a negative one to
+ * wait for as long as it takes.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHMQ_MAGIC "lab0-s\n"
+#define SHMQ_VERSION 1
+
+/* Smallest region in bytes */
+#define SHMQ_SIZE_MIN (64 << 10)
+
+typedef struct shmq shmq_t;
+
+/**
+ * shmq_elem_t - An element of a shared-memory queue
+ * @next: offset of the next element, or of the list in the header
+ * @prev: offset of the previous element, or of the list in the header
+ * @order: the block is 1 << @order bytes long
+ * @len: length of @value, without its terminator
+ * @value: the string, NUL-terminated
+ */
+typedef struct {
+    uint64_t next;
+    uint64_t prev;
+    uint32_t order;
+    uint32_t len;
+    char value[];
+} shmq_elem_t;
+
+/* Create the shared memory object name of size bytes, rounded up to
+ * SHMQ_SIZE_MIN, holding an empty queue, and map it.
+ * Return NULL with errno set if it exists already or could not be created.
+ */
+shmq_t *shmq_create(const char *name, size_t size);
+
+/* Map the queue in the shared memory object name, created by another process.
+ * Return NULL with errno set if it does not exist or does not hold a queue.
+ */
+shmq_t *shmq_attach(const char *name);
+
+/* Unmap the queue, no effect if q is NULL. The region lives on until it is
+ * unlinked and unmapped by every process.
+ */
+void shmq_detach(shmq_t *q);
+
+/* Remove the name of a shared memory object, false with errno set on failure */
+bool shmq_unlink(const char *name);
+
+/* Insert a copy of s at the tail, or at the head for shmq_insert_head(),
+ * waiting up to timeout_ms for room if the heap is full.
+ * Return false with errno set to EAGAIN if the heap is full and timeout_ms
+ * is 0, to ETIMEDOUT if it stayed full, to ENOMEM if no block large enough
+ * can ever be freed, or to E2BIG if s cannot fit in the region at all.
+ */
+bool shmq_insert_tail(shmq_t *q, const char *s, long timeout_ms);
+bool shmq_insert_head(shmq_t *q, const char *s, long timeout_ms);
+
+/* Remove the element at the head, waiting up to timeout_ms for one if the
+ * queue is empty. The element stays in the region, mapped in this process,
+ * until handed to shmq_release().
+ * Return NULL with errno set to EAGAIN if the queue is empty and timeout_ms
+ * is 0, to ETIMEDOUT if it stayed empty, or to EPIPE if it is empty and shut
+ * down.
+ */
+shmq_elem_t *shmq_remove_head(shmq_t *q, long timeout_ms);
+
+/* Give the block of a removed element back to the heap */
+void shmq_release(shmq_t *q, shmq_elem_t *e);
+
+/* Wake up every process waiting on an empty queue for good: shmq_remove_head()
+ * returns NULL once the queue is empty instead of waiting.
+ */
+void shmq_shutdown(shmq_t *q);
+
+/* Number of elements in the queue */
+int shmq_size(shmq_t *q);
+
+#endif /* LAB0_SHMQ_H */
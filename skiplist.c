@@ -0,0 +1,302 @@
+/* Indexable skip list over the nodes of a doubly-linked list */
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "skiplist.h"
+
+/* The index is bookkeeping rather than queue contents: like the bucket array
+ * of intern.c, it uses regular malloc/free. Going through the harness would
+ * make rebuilding a big index search the whole heap on every free.
+ */
+#define INTERNAL 1
+#include "harness.h"
+
+/**
+ * sl_level_t - One level of a tower
+ * @link: node in the list of towers reaching this level
+ * @width: distance in list nodes to the next tower on this level, or to the
+ *         end of the list if there is none
+ */
+typedef struct {
+    struct list_head link;
+    int width;
+} sl_level_t;
+
+/**
+ * struct sl_tower - The index entries of one list node
+ * @node: the list node, or the list head for the head tower
+ * @height: number of levels in @level
+ * @level: the levels, from the lowest up
+ *
+ * The head tower sits at position -1. Its @link members double as the heads
+ * of the per-level lists, which makes it the predecessor of the first tower
+ * and the successor of the last one on every level.
+ */
+struct sl_tower {
+    struct list_head *node;
+    int height;
+    sl_level_t level[];
+};
+
+static inline sl_tower_t *tower_of(struct list_head *link, int l)
+{
+    return (sl_tower_t *) ((char *) link - offsetof(sl_tower_t, level) -
+                           l * sizeof(sl_level_t) -
+                           offsetof(sl_level_t, link));
+}
+
+static sl_tower_t *tower_new(struct list_head *node, int height)
+{
+    sl_tower_t *t = malloc(sizeof(sl_tower_t) + height * sizeof(sl_level_t));
+    if (!t)
+        return NULL;
+
+    t->node = node;
+    t->height = height;
+    return t;
+}
+
+/* Geometric height: zero with probability 1 - 1 / SL_BRANCH, and so on */
+static int random_height(skiplist_t *sl)
+{
+    /* xorshift32 */
+    sl->seed ^= sl->seed << 13;
+    sl->seed ^= sl->seed >> 17;
+    sl->seed ^= sl->seed << 5;
+
+    int h = 0;
+    for (uint32_t r = sl->seed; h < SL_MAX_LEVEL && !(r % SL_BRANCH);
+         r /= SL_BRANCH)
+        h++;
+    return h;
+}
+
+/* Free every tower but the head one and reset it for a list of n nodes */
+static void sl_clear(skiplist_t *sl, int n)
+{
+    sl_tower_t *head = sl->head;
+    struct list_head *link, *safe;
+
+    list_for_each_safe (link, safe, &head->level[0].link)
+        free(tower_of(link, 0));
+
+    for (int l = 0; l < SL_MAX_LEVEL; l++) {
+        INIT_LIST_HEAD(&head->level[l].link);
+        head->level[l].width = n + 1;
+    }
+}
+
+/* Rebuild the towers in one pass over the n nodes of the list */
+static void sl_rebuild(skiplist_t *sl, int n)
+{
+    sl_tower_t *head = sl->head, *last[SL_MAX_LEVEL];
+    int last_pos[SL_MAX_LEVEL];
+
+    sl_clear(sl, n);
+    for (int l = 0; l < SL_MAX_LEVEL; l++) {
+        last[l] = head;
+        last_pos[l] = -1;
+    }
+
+    int pos = 0;
+    for (struct list_head *node = head->node->next; node != head->node;
+         node = node->next, pos++) {
+        int h = random_height(sl);
+        sl_tower_t *t = h ? tower_new(node, h) : NULL;
+        if (!t)
+            continue;
+
+        for (int l = 0; l < h; l++) {
+            last[l]->level[l].width = pos - last_pos[l];
+            list_add_tail(&t->level[l].link, &head->level[l].link);
+            last[l] = t;
+            last_pos[l] = pos;
+        }
+    }
+
+    for (int l = 0; l < SL_MAX_LEVEL; l++)
+        last[l]->level[l].width = n - last_pos[l];
+    sl->dirty = false;
+}
+
+/* Find the last tower before position i on every level */
+static void sl_find(skiplist_t *sl, int i, sl_tower_t **update, int *pos)
+{
+    sl_tower_t *cur = sl->head;
+    int p = -1;
+
+    for (int l = SL_MAX_LEVEL - 1; l >= 0; l--) {
+        struct list_head *end = &sl->head->level[l].link;
+        while (cur->level[l].link.next != end && p + cur->level[l].width < i) {
+            p += cur->level[l].width;
+            cur = tower_of(cur->level[l].link.next, l);
+        }
+        update[l] = cur;
+        pos[l] = p;
+    }
+}
+
+skiplist_t *sl_new(struct list_head *list)
+{
+    skiplist_t *sl = malloc(sizeof(skiplist_t));
+    if (!sl)
+        return NULL;
+
+    sl->head = tower_new(list, SL_MAX_LEVEL);
+    if (!sl->head) {
+        free(sl);
+        return NULL;
+    }
+    for (int l = 0; l < SL_MAX_LEVEL; l++)
+        INIT_LIST_HEAD(&sl->head->level[l].link);
+    sl->dirty = true;
+    sl->seed = 2463534242u;
+    return sl;
+}
+
+void sl_free(skiplist_t *sl)
+{
+    if (!sl)
+        return;
+
+    sl_clear(sl, 0);
+    free(sl->head);
+    free(sl);
+}
+
+void sl_invalidate(skiplist_t *sl)
+{
+    sl->dirty = true;
+}
+
+void sl_insert_head(skiplist_t *sl, struct list_head *node)
+{
+    if (sl->dirty)
+        return;
+
+    sl_tower_t *head = sl->head;
+    int h = random_height(sl);
+    sl_tower_t *t = h ? tower_new(node, h) : NULL;
+    if (!t)
+        h = 0;
+
+    /* Everything behind the new node moves one position up */
+    for (int l = 0; l < h; l++) {
+        t->level[l].width = head->level[l].width;
+        head->level[l].width = 1;
+        list_add(&t->level[l].link, &head->level[l].link);
+    }
+    for (int l = h; l < SL_MAX_LEVEL; l++)
+        head->level[l].width++;
+}
+
+void sl_insert_tail(skiplist_t *sl, struct list_head *node)
+{
+    if (sl->dirty)
+        return;
+
+    sl_tower_t *head = sl->head;
+    int h = random_height(sl);
+    sl_tower_t *t = h ? tower_new(node, h) : NULL;
+    if (!t)
+        h = 0;
+
+    /* The last tower of a level keeps its width if the new one follows it */
+    for (int l = 0; l < h; l++) {
+        t->level[l].width = 1;
+        list_add_tail(&t->level[l].link, &head->level[l].link);
+    }
+    for (int l = h; l < SL_MAX_LEVEL; l++)
+        tower_of(head->level[l].link.prev, l)->level[l].width++;
+}
+
+void sl_remove_head(skiplist_t *sl, struct list_head *node)
+{
+    if (sl->dirty)
+        return;
+
+    sl_tower_t *head = sl->head, *t = NULL;
+    if (!list_empty(&head->level[0].link)) {
+        t = tower_of(head->level[0].link.next, 0);
+        if (t->node != node)
+            t = NULL;
+    }
+
+    int h = t ? t->height : 0;
+    for (int l = 0; l < h; l++) {
+        head->level[l].width = t->level[l].width;
+        list_del(&t->level[l].link);
+    }
+    for (int l = h; l < SL_MAX_LEVEL; l++)
+        head->level[l].width--;
+    free(t);
+}
+
+void sl_remove_tail(skiplist_t *sl, struct list_head *node)
+{
+    if (sl->dirty)
+        return;
+
+    sl_tower_t *head = sl->head, *t = NULL;
+    if (!list_empty(&head->level[0].link)) {
+        t = tower_of(head->level[0].link.prev, 0);
+        if (t->node != node)
+            t = NULL;
+    }
+
+    int h = t ? t->height : 0;
+    for (int l = 0; l < h; l++)
+        list_del(&t->level[l].link);
+    for (int l = h; l < SL_MAX_LEVEL; l++)
+        tower_of(head->level[l].link.prev, l)->level[l].width--;
+    free(t);
+}
+
+struct list_head *sl_at(skiplist_t *sl, int n, int i)
+{
+    sl_tower_t *update[SL_MAX_LEVEL];
+    int pos[SL_MAX_LEVEL];
+
+    if (sl->dirty)
+        sl_rebuild(sl, n);
+    sl_find(sl, i, update, pos);
+
+    struct list_head *node = update[0]->node;
+    for (int p = pos[0]; p < i; p++)
+        node = node->next;
+    return node;
+}
+
+struct list_head *sl_remove_at(skiplist_t *sl, int n, int i)
+{
+    sl_tower_t *update[SL_MAX_LEVEL];
+    int pos[SL_MAX_LEVEL];
+
+    if (sl->dirty)
+        sl_rebuild(sl, n);
+    sl_find(sl, i, update, pos);
+
+    struct list_head *node = update[0]->node;
+    for (int p = pos[0]; p < i; p++)
+        node = node->next;
+
+    /* The node has a tower exactly if the next one on level 0 is at i */
+    sl_tower_t *t = NULL;
+    struct list_head *next = update[0]->level[0].link.next;
+    if (next != &sl->head->level[0].link &&
+        pos[0] + update[0]->level[0].width == i)
+        t = tower_of(next, 0);
+
+    int h = t ? t->height : 0;
+    for (int l = 0; l < h; l++) {
+        update[l]->level[l].width += t->level[l].width - 1;
+        list_del(&t->level[l].link);
+    }
+    for (int l = h; l < SL_MAX_LEVEL; l++)
+        update[l]->level[l].width--;
+    free(t);
+
+    list_del(node);
+    return node;
+}
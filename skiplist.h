@@ -0,0 +1,119 @@
+#ifndef LAB0_SKIPLIST_H
+#define LAB0_SKIPLIST_H
+
+/* Positional index over the nodes of a doubly-linked list.
+ *
+ * An indexable skip list whose bottom level is the list itself: about one
+ * node in SL_BRANCH carries a tower, one in SL_BRANCH^2 a tower of height
+ * two, and so on. Every level of a tower records how many list nodes lie
+ * between it and the next tower on that level, so the node at a given
+ * position is found in O(log n) by skipping over whole stretches of the
+ * list.
+ *
+ * Insertion and removal at either end of the list update the index in
+ * O(SL_MAX_LEVEL). Any other relinking has to be reported with
+ * sl_invalidate(); the index is then rebuilt in one pass over the list the
+ * next time a position is looked up. A node whose tower cannot be allocated
+ * simply goes without one, which costs speed but never correctness.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "list.h"
+
+/* Levels of the index, enough for 4^16 nodes */
+#define SL_MAX_LEVEL 16
+
+/* One node in SL_BRANCH gets promoted to the next level */
+#define SL_BRANCH 4
+
+typedef struct sl_tower sl_tower_t;
+
+/**
+ * skiplist_t - A positional index over one list
+ * @head: tower of the list head, spanning all levels
+ * @dirty: whether the towers are out of date and must be rebuilt
+ * @seed: state of the generator picking tower heights
+ */
+typedef struct skiplist {
+    sl_tower_t *head;
+    bool dirty;
+    uint32_t seed;
+} skiplist_t;
+
+/**
+ * sl_new() - Create an index over a list
+ * @list: header of the list
+ *
+ * The index starts out dirty and is built on the first lookup.
+ *
+ * Return: NULL for allocation failed
+ */
+skiplist_t *sl_new(struct list_head *list);
+
+/**
+ * sl_free() - Free an index and all of its towers, no effect if NULL
+ * @sl: the index
+ */
+void sl_free(skiplist_t *sl);
+
+/**
+ * sl_invalidate() - Tell the index its list was relinked
+ * @sl: the index
+ *
+ * Does not allocate or free, so it may be called in noallocate mode.
+ */
+void sl_invalidate(skiplist_t *sl);
+
+/**
+ * sl_insert_head() - Account for a node just added at the head of the list
+ * @sl: the index
+ * @node: the new first node
+ */
+void sl_insert_head(skiplist_t *sl, struct list_head *node);
+
+/**
+ * sl_insert_tail() - Account for a node just added at the tail of the list
+ * @sl: the index
+ * @node: the new last node
+ */
+void sl_insert_tail(skiplist_t *sl, struct list_head *node);
+
+/**
+ * sl_remove_head() - Account for the first node being removed
+ * @sl: the index
+ * @node: the first node of the list, about to be unlinked
+ */
+void sl_remove_head(skiplist_t *sl, struct list_head *node);
+
+/**
+ * sl_remove_tail() - Account for the last node being removed
+ * @sl: the index
+ * @node: the last node of the list, about to be unlinked
+ */
+void sl_remove_tail(skiplist_t *sl, struct list_head *node);
+
+/**
+ * sl_at() - Find the node at a position of the list
+ * @sl: the index
+ * @n: number of nodes in the list
+ * @i: 0-based position, less than @n
+ *
+ * Return: the node at position @i
+ */
+struct list_head *sl_at(skiplist_t *sl, int n, int i);
+
+/**
+ * sl_remove_at() - Unlink the node at a position of the list
+ * @sl: the index
+ * @n: number of nodes in the list
+ * @i: 0-based position, less than @n
+ *
+ * The node is removed from the index and from the list, but not freed.
+ *
+ * Return: the unlinked node
+ */
+struct list_head *sl_remove_at(skiplist_t *sl, int n, int i);
+
+#endif /* LAB0_SKIPLIST_H */
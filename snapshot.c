@@ -0,0 +1,184 @@
+/* Background snapshot of a chain of queues through fork() */
+
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* A snapshot outlives the command starting it, keep it off the harness */
+#define INTERNAL 1
+#include "harness.h"
+
+#include "qfile.h"
+#include "queue.h"
+#include "snapshot.h"
+
+/**
+ * struct snapshot - A background snapshot
+ * @pid: the child, 0 once reaped
+ * @fd: read end of the pipe from the child
+ * @faults: minor page faults of the parent right after the fork, counted
+ *          again when the child is reaped rather than when it exits
+ * @stats: what the snapshot cost
+ */
+struct snapshot {
+    pid_t pid;
+    int fd;
+    long faults;
+    snapshot_stats_t stats;
+};
+
+static inline uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static long minor_faults(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_minflt;
+}
+
+/* Write every queue of the chain to its file, in the child */
+static void save_chain(struct list_head *chain,
+                       const char *path,
+                       snapshot_stats_t *stats)
+{
+    long faults = minor_faults();
+    uint64_t start = now_ns();
+
+    queue_contex_t *ctx = NULL;
+    list_for_each_entry (ctx, chain, chain) {
+        char file[PATH_MAX];
+        struct stat st;
+        if (snprintf(file, sizeof(file), "%s.%d", path, ctx->id) >=
+            (int) sizeof(file)) {
+            stats->error = ENAMETOOLONG;
+            break;
+        }
+        if (!qfile_save(ctx->q, file) || stat(file, &st)) {
+            stats->error = errno;
+            break;
+        }
+        stats->queues++;
+        stats->elements += q_size(ctx->q);
+        stats->bytes += st.st_size;
+    }
+
+    stats->save_ns = now_ns() - start;
+    stats->child_faults = minor_faults() - faults;
+}
+
+snapshot_t *snapshot_start(struct list_head *chain, const char *path)
+{
+    if (!chain || !path) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    snapshot_t *s = malloc(sizeof(snapshot_t));
+    if (!s) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    *s = (snapshot_t){0};
+
+    int fds[2];
+    if (pipe(fds)) {
+        int err = errno;
+        free(s);
+        errno = err;
+        return NULL;
+    }
+
+    /* Anything buffered would otherwise be written by both processes */
+    fflush(NULL);
+
+    uint64_t start = now_ns();
+    s->pid = fork();
+    if (!s->pid) {
+        /* The handlers of the parent long jump back into its command loop,
+         * which the child must never run
+         */
+        signal(SIGSEGV, SIG_DFL);
+        signal(SIGALRM, SIG_DFL);
+        close(fds[0]);
+        snapshot_stats_t stats = {0};
+        save_chain(chain, path, &stats);
+        ssize_t done = write(fds[1], &stats, sizeof(stats));
+        _exit(done == sizeof(stats) && !stats.error ? 0 : 1);
+    }
+    s->stats.fork_ns = now_ns() - start;
+    s->faults = minor_faults();
+    close(fds[1]);
+
+    if (s->pid < 0) {
+        int err = errno;
+        close(fds[0]);
+        free(s);
+        errno = err;
+        return NULL;
+    }
+    s->fd = fds[0];
+    return s;
+}
+
+bool snapshot_poll(snapshot_t *s, bool wait)
+{
+    if (!s->pid)
+        return true;
+
+    int status;
+    pid_t pid;
+    do
+        pid = waitpid(s->pid, &status, wait ? 0 : WNOHANG);
+    while (pid < 0 && errno == EINTR);
+    if (!pid)
+        return false;
+
+    s->pid = 0;
+    s->stats.parent_faults = minor_faults() - s->faults;
+
+    /* The child sends its statistics unless it died on the way */
+    snapshot_stats_t child;
+    if (read(s->fd, &child, sizeof(child)) == sizeof(child)) {
+        s->stats.save_ns = child.save_ns;
+        s->stats.queues = child.queues;
+        s->stats.elements = child.elements;
+        s->stats.bytes = child.bytes;
+        s->stats.child_faults = child.child_faults;
+        s->stats.error = child.error;
+    } else {
+        s->stats.error = ECHILD;
+    }
+    if (pid > 0 && !s->stats.error &&
+        (!WIFEXITED(status) || WEXITSTATUS(status)))
+        s->stats.error = ECHILD;
+    close(s->fd);
+    s->fd = -1;
+    return true;
+}
+
+pid_t snapshot_pid(const snapshot_t *s)
+{
+    return s->pid;
+}
+
+const snapshot_stats_t *snapshot_stats(const snapshot_t *s)
+{
+    return &s->stats;
+}
+
+void snapshot_free(snapshot_t *s)
+{
+    free(s);
+}
@@ -0,0 +1,72 @@
+#ifndef LAB0_SNAPSHOT_H
+#define LAB0_SNAPSHOT_H
+
+/* Background snapshot of a chain of queues.
+ *
+ * The process forks, and the child writes every queue of the chain as it was
+ * at that instant with qfile_save(), one file per queue, while the parent
+ * goes on changing them. Both processes share their pages after the fork, and
+ * the kernel copies a page only when one of them writes to it, so the child
+ * sees a consistent point-in-time image at the cost of copying the pages the
+ * parent touches in the meantime. Once done, the child sends its statistics
+ * back through a pipe and exits.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "list.h"
+
+typedef struct snapshot snapshot_t;
+
+/**
+ * snapshot_stats_t - What a background snapshot cost
+ * @fork_ns: time taken by fork() in the parent
+ * @save_ns: time taken by the child to write the files
+ * @queues: queues written
+ * @elements: elements written
+ * @bytes: bytes written
+ * @child_faults: minor page faults taken by the child while writing
+ * @parent_faults: minor page faults taken by the parent from the fork until
+ *                 snapshot_poll() reaped the child, which may be well after
+ *                 it exited, mostly copies of pages it wrote to
+ * @error: errno of the failure in the child, 0 if every file was written
+ */
+typedef struct {
+    uint64_t fork_ns;
+    uint64_t save_ns;
+    uint64_t queues;
+    uint64_t elements;
+    uint64_t bytes;
+    uint64_t child_faults;
+    uint64_t parent_faults;
+    int error;
+} snapshot_stats_t;
+
+/**
+ * snapshot_start() - Fork a child writing a chain of queues to files
+ * @chain: head of a list of queue_contex_t linked through their chain
+ * @path: prefix of the files, each queue going to "<path>.<id>"
+ *
+ * Return: the snapshot in progress, NULL with errno set if the pipe or the
+ * child could not be created
+ */
+snapshot_t *snapshot_start(struct list_head *chain, const char *path);
+
+/* Check whether the child is done, waiting for it if wait is set, and fill
+ * in the statistics once it is.
+ * Return true if the child is done, false if it is still writing.
+ */
+bool snapshot_poll(snapshot_t *s, bool wait);
+
+/* Process ID of the child */
+pid_t snapshot_pid(const snapshot_t *s);
+
+/* Statistics of the snapshot, complete once snapshot_poll() returned true */
+const snapshot_stats_t *snapshot_stats(const snapshot_t *s);
+
+/* Free a snapshot the child of which is done, no effect if s is NULL */
+void snapshot_free(snapshot_t *s);
+
+#endif /* LAB0_SNAPSHOT_H */
@@ -0,0 +1,113 @@
+/* Single-producer/single-consumer channel of element_t pointers */
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+/* Worker threads run this code, keep it off the harness like element.c */
+#define INTERNAL 1
+#include "harness.h"
+
+#include "spsc.h"
+
+#define SPSC_CACHE_LINE 64
+
+/**
+ * struct spsc - A single-producer/single-consumer ring buffer
+ * @head: index of the next slot to write, advanced by the producer
+ * @cached_tail: the producer's copy of @tail
+ * @tail: index of the next slot to read, advanced by the consumer
+ * @cached_head: the consumer's copy of @head
+ * @mask: capacity minus one
+ * @buf: the slots, element i living at i & @mask
+ *
+ * Both indexes grow without bound and wrap around together, so @head - @tail
+ * is always the number of elements in the channel.
+ */
+struct spsc {
+    atomic_size_t head __attribute__((aligned(SPSC_CACHE_LINE)));
+    size_t cached_tail;
+    atomic_size_t tail __attribute__((aligned(SPSC_CACHE_LINE)));
+    size_t cached_head;
+    size_t mask __attribute__((aligned(SPSC_CACHE_LINE)));
+    element_t **buf;
+};
+
+spsc_t *spsc_new(size_t capacity)
+{
+    size_t cap = 1;
+    while (cap < capacity)
+        cap <<= 1;
+
+    spsc_t *ch = aligned_alloc(SPSC_CACHE_LINE, sizeof(spsc_t));
+    element_t **buf = malloc(cap * sizeof(element_t *));
+    if (!ch || !buf) {
+        free(ch);
+        free(buf);
+        return NULL;
+    }
+
+    atomic_init(&ch->head, 0);
+    atomic_init(&ch->tail, 0);
+    ch->cached_tail = ch->cached_head = 0;
+    ch->mask = cap - 1;
+    ch->buf = buf;
+    return ch;
+}
+
+void spsc_free(spsc_t *ch)
+{
+    if (!ch)
+        return;
+
+    size_t head = atomic_load(&ch->head);
+    for (size_t i = atomic_load(&ch->tail); i != head; i++)
+        element_free(ch->buf[i & ch->mask]);
+    free(ch->buf);
+    free(ch);
+}
+
+size_t spsc_push_batch(spsc_t *ch, element_t **v, size_t n)
+{
+    size_t head = atomic_load_explicit(&ch->head, memory_order_relaxed);
+    size_t room = ch->mask + 1 - (head - ch->cached_tail);
+    if (room < n) {
+        ch->cached_tail = atomic_load_explicit(&ch->tail, memory_order_acquire);
+        room = ch->mask + 1 - (head - ch->cached_tail);
+    }
+    if (n > room)
+        n = room;
+
+    for (size_t i = 0; i < n; i++)
+        ch->buf[(head + i) & ch->mask] = v[i];
+    atomic_store_explicit(&ch->head, head + n, memory_order_release);
+    return n;
+}
+
+bool spsc_push(spsc_t *ch, element_t *e)
+{
+    return spsc_push_batch(ch, &e, 1);
+}
+
+size_t spsc_pop_batch(spsc_t *ch, element_t **v, size_t n)
+{
+    size_t tail = atomic_load_explicit(&ch->tail, memory_order_relaxed);
+    size_t avail = ch->cached_head - tail;
+    if (avail < n) {
+        ch->cached_head = atomic_load_explicit(&ch->head, memory_order_acquire);
+        avail = ch->cached_head - tail;
+    }
+    if (n > avail)
+        n = avail;
+
+    for (size_t i = 0; i < n; i++)
+        v[i] = ch->buf[(tail + i) & ch->mask];
+    atomic_store_explicit(&ch->tail, tail + n, memory_order_release);
+    return n;
+}
+
+element_t *spsc_pop(spsc_t *ch)
+{
+    element_t *e = NULL;
+    spsc_pop_batch(ch, &e, 1);
+    return e;
+}
@@ -0,0 +1,63 @@
+#ifndef LAB0_SPSC_H
+#define LAB0_SPSC_H
+
+/* Single-producer/single-consumer channel of element_t pointers.
+ *
+ * A bounded ring buffer whose capacity is a power of two, with a write index
+ * advanced by the producer alone and a read index advanced by the consumer
+ * alone. Neither side needs a read-modify-write operation or a lock: each
+ * publishes its index with a release store, and the other side picks it up
+ * with an acquire load.
+ *
+ * The two indexes sit on cache lines of their own, each next to a private
+ * copy of the other side's index. A side only rereads the shared index of
+ * the other one when its copy says the buffer is full or empty, so in the
+ * steady state the two threads do not bounce cache lines at each other.
+ * Batch operations move many pointers for one index update.
+ *
+ * Elements come from element_alloc() and are released with element_free().
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "element.h"
+
+/* Default capacity of a channel */
+#define SPSC_CAPACITY 1024
+
+typedef struct spsc spsc_t;
+
+/* Create an empty channel holding up to capacity elements, rounded up to a
+ * power of two.
+ * Return NULL for allocation failed.
+ */
+spsc_t *spsc_new(size_t capacity);
+
+/* Free the channel and every element left in it, no effect if ch is NULL.
+ * Neither side may be using the channel any more.
+ */
+void spsc_free(spsc_t *ch);
+
+/* Send an element. Only the producer may call this.
+ * Return false if the channel is full.
+ */
+bool spsc_push(spsc_t *ch, element_t *e);
+
+/* Send up to n elements from v, in order. Only the producer may call this.
+ * Return the number of elements sent, less than n if the channel filled up.
+ */
+size_t spsc_push_batch(spsc_t *ch, element_t **v, size_t n);
+
+/* Receive an element. Only the consumer may call this.
+ * Return NULL if the channel is empty.
+ */
+element_t *spsc_pop(spsc_t *ch);
+
+/* Receive up to n elements into v, in order. Only the consumer may call
+ * this.
+ * Return the number of elements received, zero if the channel is empty.
+ */
+size_t spsc_pop_batch(spsc_t *ch, element_t **v, size_t n);
+
+#endif /* LAB0_SPSC_H */
@@ -0,0 +1,10 @@
+# Test if time complexity of insertion and removal at both ends of the
+# ring-buffer deque is constant
+option ring 1
+option simulation 1
+it
+ih
+rh
+rt
+option simulation 0
+option ring 0
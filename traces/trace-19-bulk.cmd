@@ -0,0 +1,26 @@
+# Test of removing several elements from the head at once, and of removing
+# elements whose values are numbers
+option fail 0
+option malloc 0
+new
+it 1
+it 2
+it 3
+it 4
+it 5
+rhn 2
+rh 3
+ih 10
+rh 10
+rhn 1
+rh 5
+it 6
+it 7
+rhn 5
+size
+ih 9
+it 8
+rt 8
+rh 9
+rhn 3
+free
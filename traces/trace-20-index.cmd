@@ -0,0 +1,38 @@
+# Test of positional access and deletion through the index of a queue
+option fail 0
+option malloc 0
+option debug 1
+new
+index 1
+it c
+it d
+it e
+ih b
+ih a
+at 0 a
+at 4 e
+dat 2
+at 2 d
+ih z
+at 0 z
+rt e
+dm
+at 2 d
+reverse
+at 0 d
+swap
+at 0 a
+sort
+at 1 d
+at 2 z
+it dolphin 1000
+at 500 dolphin
+dat 3
+at 3 dolphin
+at 999 dolphin
+index 0
+at 1 d
+dat 0
+at 0 d
+at 998 dolphin
+free
@@ -0,0 +1,35 @@
+# Test of deleting duplicate strings from unsorted queues
+option fail 0
+option malloc 0
+new
+it b
+it a
+it b
+it c
+it a
+it d
+dedup all
+rh c
+rh d
+it b
+it a
+it b
+it c
+it a
+it d
+dedup first
+rh b
+rh a
+rh c
+rh d
+ih gerbil 100
+it bear
+dedup first
+rh gerbil
+rh bear
+dedup all
+it RAND 1000
+it RAND 1000
+dedup first
+dedup all
+free
@@ -0,0 +1,46 @@
+# Test of queue operations while a lazy reversal is pending
+option fail 0
+option malloc 0
+option debug 1
+new
+lazyrev 1
+it a
+it b
+it c
+it d
+it e
+reverse
+rh e
+rt a
+ih f
+it g
+at 1 d
+reverse
+rh g
+sort
+rh b
+it a
+reverse
+option descend 1
+sort
+rh f
+rt a
+option descend 0
+it b
+it e
+reverse
+swap
+rh b
+reverseK 2
+rh d
+it z
+it y
+reverse
+descend
+rh z
+it x
+reverse
+lazyrev 0
+rh x
+rh e
+free
@@ -0,0 +1,39 @@
+# Test of saving queues to files and loading them back, and of loading a
+# file which does not hold a queue
+option fail 10
+option malloc 0
+option debug 1
+new
+it gerbil
+it bear
+it dolphin
+save /tmp/lab0-trace-23.q
+ih zebra
+load /tmp/lab0-trace-23.q
+rh zebra
+rh gerbil
+rh bear
+rh dolphin
+lazyrev 1
+reverse
+save /tmp/lab0-trace-23.q
+new
+load /tmp/lab0-trace-23.q
+load /tmp/lab0-trace-23.q
+rh dolphin
+rh bear
+rh gerbil
+rt gerbil
+sort
+load traces/trace-eg.cmd
+rh bear
+rh dolphin
+size
+new
+it RAND 1000
+save /tmp/lab0-trace-23.q
+load /tmp/lab0-trace-23.q
+sort
+free
+free
+free
@@ -0,0 +1,42 @@
+# Test of replaying a journal, including one whose last records were torn
+option fail 0
+option malloc 0
+option jbatch 1
+option jdelay 0
+new
+journal /tmp/lab0-trace-24.j new
+it gerbil
+it bear
+ih dolphin
+it meerkat
+reverse
+rh meerkat
+sort
+dm
+ih vulture
+journal off
+free
+new
+journal /tmp/lab0-trace-24.j
+rh vulture
+it zebra
+option jbatch 0
+it bear
+it gerbil
+journal crash 20
+free
+new
+journal /tmp/lab0-trace-24.j
+rh bear
+rh gerbil
+rh zebra
+rh bear
+size
+ih squirrel
+journal off
+free
+new
+lazyrev 1
+journal /tmp/lab0-trace-24.j
+rh squirrel
+free
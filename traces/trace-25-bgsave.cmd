@@ -0,0 +1,44 @@
+# Test of saving every queue in the background while the queues change, and
+# of loading the files back as they were when the save started
+option fail 10
+option malloc 0
+option debug 1
+new
+it gerbil
+it bear
+it dolphin
+new
+ih RAND 1000
+it meerkat
+bgsave /tmp/lab0-trace-25
+rt meerkat
+it vulture
+prev
+rh gerbil
+ih zebra
+bgsave wait
+new
+load /tmp/lab0-trace-25.0
+rh gerbil
+rh bear
+rh dolphin
+size 0
+load /tmp/lab0-trace-25.1
+rt meerkat
+size 1000
+bgsave /tmp/lab0-trace-25
+bgsave wait
+new
+load /tmp/lab0-trace-25.0
+rh zebra
+rh bear
+rh dolphin
+size 0
+load /tmp/lab0-trace-25.1
+rt vulture
+size 1000
+bgsave wait
+free
+free
+free
+free
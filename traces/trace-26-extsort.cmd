@@ -0,0 +1,31 @@
+# Test of sorting a queue through the external merge sort, spilling runs to
+# temporary files under a small memory budget
+option fail 0
+option malloc 0
+option extbudget 4
+new
+it gerbil
+it bear
+it dolphin
+it meerkat
+it bear
+extsort
+rh bear
+rh bear
+rh dolphin
+rh gerbil
+rh meerkat
+ih RAND 20000
+extsort
+size 20000
+option descend 1
+lazyrev 1
+reverse
+extsort
+option descend 0
+it a
+ih ~
+extsort
+rh a
+rt ~
+free
@@ -0,0 +1,35 @@
+# Test of inserting many elements at once with validation off, which hands
+# them to the bulk insertion, including batches which fail to allocate
+option fail 10
+option malloc 0
+option validate 0
+new
+it gerbil 3
+ih dolphin 2
+it bear 1
+size 6
+rh dolphin
+rh dolphin
+rhn 2
+rh gerbil
+rt bear
+size 0
+it RAND 3000
+ih meerkat 2000
+size 5000
+rh meerkat
+rt
+reverse
+it zebra 1500
+ih vulture 1500
+size 7998
+rh vulture
+rt zebra
+option malloc 1
+it RAND 3000
+option malloc 0
+size 7996
+ih bear
+rh bear
+sort
+free
@@ -0,0 +1,66 @@
+# Test of sorting, merging and deleting duplicates on the shared strings of
+# option intern 1, which has to give the same results as on copies
+option fail 0
+option malloc 0
+option intern 1
+new
+ih dolphin
+ih bear
+ih gerbil
+ih bear
+ih aardvark
+sort
+rh aardvark
+rh bear
+rh bear
+rh dolphin
+rh gerbil
+it RAND 20000
+sort
+option descend 1
+sort
+option descend 0
+reverse
+sort
+free
+new
+it b
+it e
+it a
+it d
+it c
+it a
+sort
+new
+it f
+it b
+it g
+it a
+sort
+merge
+size 10
+dedup
+rh c
+rh d
+rh e
+rh f
+rh g
+size 0
+free
+free
+new
+it RAND 3000
+sort
+new
+it RAND 3000
+ih RAND 3000
+sort
+new
+it RAND 3000
+sort
+merge
+size 12000
+dedup
+free
+free
+free
@@ -0,0 +1,246 @@
+#include <string.h>
+
+#include "harness.h"
+#include "unrolled.h"
+
+/* Create an empty queue */
+unrolled_queue_t *uq_new()
+{
+    unrolled_queue_t *q = malloc(sizeof(*q));
+    if (!q)
+        return NULL;
+
+    INIT_LIST_HEAD(&q->chunks);
+    q->spare = NULL;
+    q->size = 0;
+    return q;
+}
+
+/* Whether a value lies in the bytes of its chunk, or was allocated alone */
+static inline bool value_inline(const uq_chunk_t *chunk, const char *value)
+{
+    return value >= chunk->bytes && value < chunk->bytes + UQ_CHUNK_BYTES;
+}
+
+/* Free all storage used by queue */
+void uq_free(unrolled_queue_t *q)
+{
+    if (!q)
+        return;
+
+    uq_chunk_t *chunk = NULL, *safe = NULL;
+    list_for_each_entry_safe (chunk, safe, &q->chunks, list) {
+        for (int i = chunk->first; i < chunk->first + chunk->count; i++) {
+            if (!value_inline(chunk, chunk->values[i]))
+                free(chunk->values[i]);
+        }
+        free(chunk);
+    }
+    free(q->spare);
+    free(q);
+}
+
+/* Get an empty chunk, the spare one if any, whose free slots and bytes all
+ * lie before @first if it is UQ_CHUNK_SIZE, after it if it is 0
+ */
+static uq_chunk_t *chunk_new(unrolled_queue_t *q, int first)
+{
+    uq_chunk_t *chunk = q->spare;
+    if (chunk)
+        q->spare = NULL;
+    else if (!(chunk = malloc(sizeof(*chunk))))
+        return NULL;
+
+    chunk->first = first;
+    chunk->count = 0;
+    chunk->lo = chunk->hi = first ? UQ_CHUNK_BYTES : 0;
+    return chunk;
+}
+
+/* Unlink a chunk which became empty, keeping it as the spare one if there is
+ * none yet
+ */
+static void chunk_drop(unrolled_queue_t *q, uq_chunk_t *chunk)
+{
+    list_del(&chunk->list);
+    if (q->spare)
+        free(chunk);
+    else
+        q->spare = chunk;
+}
+
+/* Whether a string of len bytes, terminator included, fits before/after the
+ * values of chunk; one too long for any chunk is allocated on its own
+ */
+static inline bool room_head(const uq_chunk_t *chunk, size_t len)
+{
+    return chunk->first > 0 &&
+           (len > UQ_CHUNK_BYTES || (size_t) chunk->lo >= len);
+}
+
+static inline bool room_tail(const uq_chunk_t *chunk, size_t len)
+{
+    return chunk->first + chunk->count < UQ_CHUNK_SIZE &&
+           (len > UQ_CHUNK_BYTES ||
+            (size_t) (UQ_CHUNK_BYTES - chunk->hi) >= len);
+}
+
+/* Insert a copy of s at head of queue */
+bool uq_insert_head(unrolled_queue_t *q, const char *s)
+{
+    if (!q)
+        return false;
+
+    size_t len = strlen(s) + 1;
+    uq_chunk_t *chunk = list_empty(&q->chunks)
+                            ? NULL
+                            : list_first_entry(&q->chunks, uq_chunk_t, list);
+    if (!chunk || !room_head(chunk, len)) {
+        chunk = chunk_new(q, UQ_CHUNK_SIZE);
+        if (!chunk)
+            return false;
+        list_add(&chunk->list, &q->chunks);
+    }
+
+    char *value;
+    if (len <= UQ_CHUNK_BYTES) {
+        chunk->lo -= len;
+        value = memcpy(chunk->bytes + chunk->lo, s, len);
+    } else if (!(value = strdup(s))) {
+        if (!chunk->count)
+            chunk_drop(q, chunk);
+        return false;
+    }
+
+    chunk->values[--chunk->first] = value;
+    chunk->count++;
+    q->size++;
+    return true;
+}
+
+/* Insert a copy of s at tail of queue */
+bool uq_insert_tail(unrolled_queue_t *q, const char *s)
+{
+    if (!q)
+        return false;
+
+    size_t len = strlen(s) + 1;
+    uq_chunk_t *chunk = list_empty(&q->chunks)
+                            ? NULL
+                            : list_last_entry(&q->chunks, uq_chunk_t, list);
+    if (!chunk || !room_tail(chunk, len)) {
+        chunk = chunk_new(q, 0);
+        if (!chunk)
+            return false;
+        list_add_tail(&chunk->list, &q->chunks);
+    }
+
+    char *value;
+    if (len <= UQ_CHUNK_BYTES) {
+        value = memcpy(chunk->bytes + chunk->hi, s, len);
+        chunk->hi += len;
+    } else if (!(value = strdup(s))) {
+        if (!chunk->count)
+            chunk_drop(q, chunk);
+        return false;
+    }
+
+    chunk->values[chunk->first + chunk->count++] = value;
+    q->size++;
+    return true;
+}
+
+/* Copy out and free a value taken from a chunk, dropping the chunk once it
+ * is empty. The bytes of a string at either end of those in use are given
+ * back right away.
+ */
+static void take_value(unrolled_queue_t *q,
+                       uq_chunk_t *chunk,
+                       char *value,
+                       char *sp,
+                       size_t bufsize)
+{
+    if (sp && bufsize) {
+        strncpy(sp, value, bufsize);
+        sp[bufsize - 1] = '\0';
+    }
+    if (!value_inline(chunk, value)) {
+        free(value);
+    } else if (value == chunk->bytes + chunk->lo) {
+        chunk->lo += strlen(value) + 1;
+    } else {
+        size_t len = strlen(value) + 1;
+        if (value + len == chunk->bytes + chunk->hi)
+            chunk->hi -= len;
+    }
+    if (!chunk->count)
+        chunk_drop(q, chunk);
+    q->size--;
+}
+
+/* Remove the value at head of queue */
+bool uq_remove_head(unrolled_queue_t *q, char *sp, size_t bufsize)
+{
+    if (!q || list_empty(&q->chunks))
+        return false;
+
+    uq_chunk_t *chunk = list_first_entry(&q->chunks, uq_chunk_t, list);
+    chunk->count--;
+    take_value(q, chunk, chunk->values[chunk->first++], sp, bufsize);
+    return true;
+}
+
+/* Remove the value at tail of queue */
+bool uq_remove_tail(unrolled_queue_t *q, char *sp, size_t bufsize)
+{
+    if (!q || list_empty(&q->chunks))
+        return false;
+
+    uq_chunk_t *chunk = list_last_entry(&q->chunks, uq_chunk_t, list);
+    chunk->count--;
+    take_value(q, chunk, chunk->values[chunk->first + chunk->count], sp,
+               bufsize);
+    return true;
+}
+
+/* Return the number of values in queue */
+int uq_size(unrolled_queue_t *q)
+{
+    return q ? q->size : 0;
+}
+
+/* Reverse the order of the chunks, and of the values inside each of them.
+ * The strings stay where they are in the bytes of their chunk.
+ */
+void uq_reverse(unrolled_queue_t *q)
+{
+    if (!q)
+        return;
+
+    uq_chunk_t *chunk = NULL, *safe = NULL;
+    list_for_each_entry_safe (chunk, safe, &q->chunks, list) {
+        char **lo = &chunk->values[chunk->first];
+        char **hi = lo + chunk->count - 1;
+        for (; lo < hi; lo++, hi--) {
+            char *tmp = *lo;
+            *lo = *hi;
+            *hi = tmp;
+        }
+        list_move(&chunk->list, &q->chunks);
+    }
+}
+
+/* Call fn on every value from head to tail */
+void uq_for_each(unrolled_queue_t *q,
+                 void (*fn)(const char *, void *),
+                 void *arg)
+{
+    if (!q)
+        return;
+
+    uq_chunk_t *chunk = NULL;
+    list_for_each_entry (chunk, &q->chunks, list) {
+        for (int i = chunk->first; i < chunk->first + chunk->count; i++)
+            fn(chunk->values[i], arg);
+    }
+}
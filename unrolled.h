@@ -0,0 +1,99 @@
+#ifndef LAB0_UNROLLED_H
+#define LAB0_UNROLLED_H
+
+/* Unrolled linked-list queue.
+ *
+ * Instead of one list node per element, the values are kept in chunks of
+ * UQ_CHUNK_SIZE string pointers, and only the chunks are linked together.
+ * Each chunk also holds the strings its slots point to, packed into
+ * UQ_CHUNK_BYTES bytes from the end the chunk grows at, so a value takes no
+ * allocation of its own unless it is too long to fit there. The bytes of a
+ * removed string are only reused once its chunk is empty. The queue keeps one
+ * empty chunk spare, so inserting and removing back and forth across the
+ * boundary of a chunk does not allocate and free a chunk every time.
+ *
+ * This saves the list_head and the allocation per element, and lets
+ * traversal visit many values per cache miss on the links.
+ *
+ * This is a structure for benchmarks only, not a backend of the queue: it
+ * offers what the 'bench' command compares the backends on, insertion and
+ * removal at either end, size, reversal and traversal, and no qtest option
+ * or trace runs the queue commands on it. The q_* interface of queue.h hands
+ * its element_t, list_head included, to its callers, so it cannot run on
+ * chunks and stays on the intrusive list.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "list.h"
+
+#define UQ_CHUNK_SIZE 64
+
+/* Bytes of strings held in a chunk, enough to fill every slot with a string
+ * of 9 characters
+ */
+#define UQ_CHUNK_BYTES (UQ_CHUNK_SIZE * 10)
+
+/**
+ * uq_chunk_t - A chunk of an unrolled queue
+ * @list: node of the doubly-linked list of chunks
+ * @first: slot of the first value in use
+ * @count: number of consecutive slots in use, starting at @first
+ * @lo: start of the bytes of @bytes taken by strings
+ * @hi: end of the bytes of @bytes taken by strings
+ * @values: the slots, pointing into @bytes or to strings of their own
+ * @bytes: storage of the strings inserted into the chunk
+ */
+typedef struct {
+    struct list_head list;
+    int first, count;
+    int lo, hi;
+    char *values[UQ_CHUNK_SIZE];
+    char bytes[UQ_CHUNK_BYTES];
+} uq_chunk_t;
+
+/**
+ * unrolled_queue_t - An unrolled queue
+ * @chunks: list of chunks, none of them empty
+ * @spare: an empty chunk kept for the next one needed, or NULL
+ * @size: the number of values in the queue
+ */
+typedef struct {
+    struct list_head chunks;
+    uq_chunk_t *spare;
+    int size;
+} unrolled_queue_t;
+
+/* Create an empty queue, NULL for allocation failed */
+unrolled_queue_t *uq_new();
+
+/* Free all storage used by queue, no effect if q is NULL */
+void uq_free(unrolled_queue_t *q);
+
+/* Insert a copy of s at head/tail of queue.
+ * Return false for allocation failed or queue is NULL.
+ */
+bool uq_insert_head(unrolled_queue_t *q, const char *s);
+bool uq_insert_tail(unrolled_queue_t *q, const char *s);
+
+/* Remove the value at head/tail of queue and free it.
+ * If sp is non-NULL, the value is copied to it first, with at most
+ * bufsize - 1 characters plus a null terminator.
+ * Return false if queue is NULL or empty.
+ */
+bool uq_remove_head(unrolled_queue_t *q, char *sp, size_t bufsize);
+bool uq_remove_tail(unrolled_queue_t *q, char *sp, size_t bufsize);
+
+/* Return the number of values in queue, zero if queue is NULL */
+int uq_size(unrolled_queue_t *q);
+
+/* Reverse the values in queue */
+void uq_reverse(unrolled_queue_t *q);
+
+/* Call fn on every value from head to tail */
+void uq_for_each(unrolled_queue_t *q,
+                 void (*fn)(const char *, void *),
+                 void *arg);
+
+#endif /* LAB0_UNROLLED_H */
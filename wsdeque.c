@@ -0,0 +1,171 @@
+/* Chase-Lev work-stealing deque */
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Worker threads run this code, keep it off the harness like element.c */
+#define INTERNAL 1
+#include "harness.h"
+
+#include "wsdeque.h"
+
+#define WSQ_CACHE_LINE 64
+
+/**
+ * wsq_array_t - The circular array of a deque
+ * @mask: capacity minus one, the capacity being a power of two
+ * @prev: the array this one replaced, NULL for the first one
+ * @buf: slots of the elements, element i living at i & @mask
+ */
+typedef struct wsq_array {
+    int64_t mask;
+    struct wsq_array *prev;
+    _Atomic(element_t *) buf[];
+} wsq_array_t;
+
+/**
+ * struct wsdeque - A work-stealing deque
+ * @top: index of the oldest element, advanced by thieves and the owner
+ * @bottom: index one past the newest element, moved by the owner only
+ * @array: the current array
+ *
+ * The elements are those from @top up to but not including @bottom. Thieves
+ * hammer @top while the owner works on @bottom, so the two are kept on
+ * separate cache lines.
+ */
+struct wsdeque {
+    atomic_int_fast64_t top __attribute__((aligned(WSQ_CACHE_LINE)));
+    atomic_int_fast64_t bottom __attribute__((aligned(WSQ_CACHE_LINE)));
+    _Atomic(wsq_array_t *) array;
+};
+
+static wsq_array_t *array_new(int64_t capacity, wsq_array_t *prev)
+{
+    wsq_array_t *a =
+        malloc(sizeof(wsq_array_t) + capacity * sizeof(_Atomic(element_t *)));
+    if (!a)
+        return NULL;
+
+    a->mask = capacity - 1;
+    a->prev = prev;
+    return a;
+}
+
+wsdeque_t *wsq_new()
+{
+    wsdeque_t *q = aligned_alloc(WSQ_CACHE_LINE, sizeof(wsdeque_t));
+    wsq_array_t *a = array_new(WSQ_MIN_CAPACITY, NULL);
+    if (!q || !a) {
+        free(q);
+        free(a);
+        return NULL;
+    }
+
+    atomic_init(&q->top, 0);
+    atomic_init(&q->bottom, 0);
+    atomic_init(&q->array, a);
+    return q;
+}
+
+void wsq_free(wsdeque_t *q)
+{
+    if (!q)
+        return;
+
+    wsq_array_t *a = atomic_load(&q->array);
+    int64_t b = atomic_load(&q->bottom);
+    for (int64_t i = atomic_load(&q->top); i < b; i++)
+        element_free(atomic_load(&a->buf[i & a->mask]));
+
+    while (a) {
+        wsq_array_t *prev = a->prev;
+        free(a);
+        a = prev;
+    }
+    free(q);
+}
+
+/* Copy the elements from t to b into an array of twice the capacity */
+static wsq_array_t *wsq_grow(wsdeque_t *q, wsq_array_t *a, int64_t t, int64_t b)
+{
+    wsq_array_t *bigger = array_new(2 * (a->mask + 1), a);
+    if (!bigger)
+        return NULL;
+
+    for (int64_t i = t; i < b; i++) {
+        element_t *e = atomic_load_explicit(&a->buf[i & a->mask],
+                                            memory_order_relaxed);
+        atomic_store_explicit(&bigger->buf[i & bigger->mask], e,
+                              memory_order_relaxed);
+    }
+    atomic_store_explicit(&q->array, bigger, memory_order_release);
+    return bigger;
+}
+
+bool wsq_push(wsdeque_t *q, const char *s)
+{
+    element_t *e = element_alloc(s);
+    if (!e)
+        return false;
+
+    int64_t b = atomic_load_explicit(&q->bottom, memory_order_relaxed);
+    int64_t t = atomic_load_explicit(&q->top, memory_order_acquire);
+    wsq_array_t *a = atomic_load_explicit(&q->array, memory_order_relaxed);
+    if (b - t > a->mask) {
+        a = wsq_grow(q, a, t, b);
+        if (!a) {
+            element_free(e);
+            return false;
+        }
+    }
+
+    /* A release store rather than the paper's release fence followed by a
+     * relaxed one: the same ordering, and one ThreadSanitizer understands.
+     */
+    atomic_store_explicit(&a->buf[b & a->mask], e, memory_order_relaxed);
+    atomic_store_explicit(&q->bottom, b + 1, memory_order_release);
+    return true;
+}
+
+element_t *wsq_pop(wsdeque_t *q)
+{
+    int64_t b = atomic_load_explicit(&q->bottom, memory_order_relaxed) - 1;
+    wsq_array_t *a = atomic_load_explicit(&q->array, memory_order_relaxed);
+    atomic_store_explicit(&q->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t t = atomic_load_explicit(&q->top, memory_order_relaxed);
+
+    element_t *e = NULL;
+    if (t <= b) {
+        e = atomic_load_explicit(&a->buf[b & a->mask], memory_order_relaxed);
+        if (t == b) {
+            /* The last element, which a thief may be taking as well */
+            if (!atomic_compare_exchange_strong_explicit(
+                    &q->top, &t, t + 1, memory_order_seq_cst,
+                    memory_order_relaxed))
+                e = NULL;
+            atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+        }
+    } else {
+        atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+    }
+    return e;
+}
+
+element_t *wsq_steal(wsdeque_t *q)
+{
+    int64_t t = atomic_load_explicit(&q->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = atomic_load_explicit(&q->bottom, memory_order_acquire);
+    if (t >= b)
+        return NULL;
+
+    wsq_array_t *a = atomic_load_explicit(&q->array, memory_order_acquire);
+    element_t *e =
+        atomic_load_explicit(&a->buf[t & a->mask], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(
+            &q->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+        return NULL;
+    return e;
+}
@@ -0,0 +1,61 @@
+#ifndef LAB0_WSDEQUE_H
+#define LAB0_WSDEQUE_H
+
+/* Chase-Lev work-stealing deque.
+ *
+ * A deque owned by one thread, which pushes and pops elements at its bottom
+ * end like a stack, while any other thread may steal the element at the top
+ * end. The elements live in a circular array indexed by two ever-growing
+ * counters, top and bottom; the owner alone moves bottom, and thieves race
+ * for top with compare-and-swap. The owner only has to compete with the
+ * thieves for the very last element, so a busy owner runs almost without
+ * atomic read-modify-write operations.
+ *
+ * When the array is full, the owner copies the elements into one of twice
+ * the size. A thief may still be reading the old array, so replaced arrays
+ * are only freed along with the deque. The memory orders follow Le et al.,
+ * "Correct and Efficient Work-Stealing for Weak Memory Models" (PPoPP 2013).
+ *
+ * The deque carries element_t values from element_alloc().
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "element.h"
+
+/* Initial capacity of the array, a power of two */
+#define WSQ_MIN_CAPACITY 64
+
+typedef struct wsdeque wsdeque_t;
+
+/* Create an empty deque, NULL for allocation failed */
+wsdeque_t *wsq_new();
+
+/* Free the deque and every element left in it, no effect if q is NULL.
+ * No thread may be using the deque any more.
+ */
+void wsq_free(wsdeque_t *q);
+
+/* Push an element holding a copy of s at the bottom of deque.
+ * Only the owner of the deque may call this.
+ * Return false for allocation failed.
+ */
+bool wsq_push(wsdeque_t *q, const char *s);
+
+/* Pop the element at the bottom of deque, the one pushed last.
+ * Only the owner of the deque may call this. The caller releases the element
+ * with element_free().
+ * Return NULL if the deque is empty.
+ */
+element_t *wsq_pop(wsdeque_t *q);
+
+/* Steal the element at the top of deque, the oldest one.
+ * Any thread may call this. The caller releases the element with
+ * element_free().
+ * Return NULL if the deque is empty, or if another thread took the element
+ * first, in which case trying again may succeed.
+ */
+element_t *wsq_steal(wsdeque_t *q);
+
+#endif /* LAB0_WSDEQUE_H */